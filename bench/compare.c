@@ -0,0 +1,486 @@
+/**
+ * @file compare.c
+ *
+ * Baseline comparison and statistical regression detection for jitter results.
+ * Takes a baseline and a candidate, either two captures written by RPISignal
+ * (-o) or two reports written by RPISignalSweep, and reports the deltas of the
+ * percentiles and the max. For captures a two-sample Kolmogorov-Smirnov test
+ * and a bootstrap confidence interval of the p99.9 delta are computed as well.
+ *
+ * Exit status: 0 if no threshold is exceeded, 1 on a regression (including a
+ * sweep cell that is missing or failed in the candidate), 2 on errors.
+ *
+ * Example:
+ *   ./RPISignalCompare -f 1000 -T p99:2000 -T p999:5000 -T max:20000 -k base.csv new.csv
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "../inc/config.h"
+#include "../inc/stats.h"
+
+
+#define SEC_IN_NS           1000000000UL
+#define HALF_PERIOD_NS(freq)     (SEC_IN_NS / ( 2 * freq ))
+
+#define EXIT_REGRESSION     1
+#define EXIT_ERROR          2
+
+#define DEFAULT_ALPHA       0.01            /* Significance level of the KS test */
+#define DEFAULT_BOOTSTRAP   200             /* Bootstrap resamples for the p99.9 confidence interval */
+#define DEFAULT_CONFIDENCE  0.95            /* Confidence level of the bootstrap interval */
+
+#define REPORT_LINE_MAX     1024
+#define REPORT_MAX_COLUMNS  32
+#define REPORT_KEY_COLUMNS  6               /* wait,freq,prio,core,device,load identify a sweep cell */
+
+typedef enum {
+    METRIC_P50,
+    METRIC_P90,
+    METRIC_P99,
+    METRIC_P999,
+    METRIC_MAX,
+    NUM_METRICS,
+} metric_t;
+
+static const char* metric_names[NUM_METRICS] = { "p50", "p90", "p99", "p999", "max" };
+static const char* metric_columns[NUM_METRICS] = { "p50_ns", "p90_ns", "p99_ns", "p999_ns", "max_abs_ns" };
+static const char* key_columns[REPORT_KEY_COLUMNS] = { "wait", "freq", "prio", "core", "device", "load" };
+
+typedef struct {
+    uint64_t        expected_ns;            /* 0: use the baseline median */
+    int64_t         threshold[NUM_METRICS]; /* Max. allowed increase in ns, -1 if unchecked */
+    bool            fail_on_ks;
+    double          alpha;
+    unsigned int    bootstrap;
+    uint64_t        seed;
+} compare_args_t;
+
+
+/**
+ * @brief Print help message for command line arguments.
+ */
+static void print_help(const char* progname) {
+    printf("Usage: %s [options] <baseline> <candidate>\n", progname);
+    printf("Both files are either RPISignal captures (-o) or RPISignalSweep reports.\n");
+    printf("Options:\n");
+    printf("  -f <freq>\t\tSignal frequency of the captures in Hz (default: baseline median as reference)\n");
+    printf("  -T <metric>:<ns>\tFail if <metric> (p50,p90,p99,p999,max) increases by more than <ns>\n");
+    printf("  -k \t\t\tFail if the KS test rejects equal distributions\n");
+    printf("  -a <alpha>\t\tSignificance level of the KS test (default %.2f)\n", DEFAULT_ALPHA);
+    printf("  -B <iterations>\tBootstrap resamples for p99.9, 0 to disable (default %d)\n", DEFAULT_BOOTSTRAP);
+    printf("  -s <seed>\t\tSeed of the bootstrap for reproducible results\n");
+    printf("  -h \t\t\tShow this help message\n");
+}
+
+
+/**
+ * @brief Check a metric delta against its threshold and print the result line.
+ *
+ * @return bool true if the threshold is exceeded.
+ */
+static bool check_metric(const compare_args_t* args, metric_t metric, int64_t base, int64_t cand) {
+    int64_t delta = cand - base;
+    bool regression = (args->threshold[metric] >= 0 && delta > args->threshold[metric]);
+
+    printf("  %-6s %12" PRId64 " %12" PRId64 " %+12" PRId64, metric_names[metric], base, cand, delta);
+    if (base != 0) {
+        printf(" %+8.1f%%", 100.0 * (double)delta / (double)llabs(base));
+    } else {
+        printf(" %9s", "");
+    }
+    if (args->threshold[metric] >= 0) {
+        printf("  %s (limit +%" PRId64 ")", regression ? "REGRESSION" : "ok", args->threshold[metric]);
+    }
+    printf("\n");
+
+    return regression;
+}
+
+
+/**
+ * @brief Compare two captures of toggle intervals.
+ *
+ * @return int Exit status.
+ */
+static int compare_captures(const compare_args_t* args, const char* base_file, const char* cand_file) {
+    uint64_t *base = NULL, *cand = NULL;
+    size_t nbase = 0, ncand = 0;
+
+    if (stats_load_csv(base_file, &base, &nbase) != 0 || stats_load_csv(cand_file, &cand, &ncand) != 0) {
+        free(base);
+        return EXIT_ERROR;
+    }
+    if (nbase == 0 || ncand == 0) {
+        fprintf(stderr, "No samples in %s\n", (nbase == 0) ? base_file : cand_file);
+        free(base);
+        free(cand);
+        return EXIT_ERROR;
+    }
+
+    /* Without a frequency, jitter is relative to the baseline median */
+    uint64_t expected = args->expected_ns;
+    jitter_stats_t sbase, scand;
+    if (expected == 0) {
+        stats_compute(base, nbase, 0, UINT64_MAX / 2, &sbase);
+        expected = (uint64_t)sbase.p50;
+    }
+    stats_compute(base, nbase, expected, DEADLINE_TOLERANCE_NS, &sbase);
+    stats_compute(cand, ncand, expected, DEADLINE_TOLERANCE_NS, &scand);
+
+    printf("Jitter relative to %" PRIu64 " ns, baseline %zu samples, candidate %zu samples\n\n",
+        expected, nbase, ncand);
+    printf("  %-6s %12s %12s %12s %9s\n", "metric", "baseline", "candidate", "delta", "");
+
+    bool regression = false;
+    regression |= check_metric(args, METRIC_P50, sbase.p50, scand.p50);
+    regression |= check_metric(args, METRIC_P90, sbase.p90, scand.p90);
+    regression |= check_metric(args, METRIC_P99, sbase.p99, scand.p99);
+
+    /* p99.9 is judged by the lower bound of the bootstrap interval, not the point estimate */
+    bootstrap_result_t boot;
+    bool have_boot = (args->bootstrap > 0 &&
+        stats_bootstrap_delta(base, nbase, cand, ncand, 99.9, args->bootstrap, DEFAULT_CONFIDENCE,
+                              args->seed, &boot) == 0);
+    if (have_boot && args->threshold[METRIC_P999] >= 0) {
+        compare_args_t point = *args;
+        point.threshold[METRIC_P999] = -1;
+        check_metric(&point, METRIC_P999, sbase.p999, scand.p999);
+        bool boot_regression = (boot.ci_low > (double)args->threshold[METRIC_P999]);
+        printf("  %-6s bootstrap %.0f%% CI of delta [%+.0f, %+.0f]  %s (limit +%" PRId64 ")\n", "",
+            DEFAULT_CONFIDENCE * 100.0, boot.ci_low, boot.ci_high,
+            boot_regression ? "REGRESSION" : "ok", args->threshold[METRIC_P999]);
+        regression |= boot_regression;
+    } else {
+        regression |= check_metric(args, METRIC_P999, sbase.p999, scand.p999);
+        if (have_boot) {
+            printf("  %-6s bootstrap %.0f%% CI of delta [%+.0f, %+.0f]\n", "",
+                DEFAULT_CONFIDENCE * 100.0, boot.ci_low, boot.ci_high);
+        }
+    }
+
+    regression |= check_metric(args, METRIC_MAX, sbase.max_abs, scand.max_abs);
+
+    printf("  %-6s %12zu %12zu %+12" PRId64 "\n", "overrun", sbase.overruns, scand.overruns,
+        (int64_t)scand.overruns - (int64_t)sbase.overruns);
+
+    ks_result_t ks;
+    if (stats_ks_test(base, nbase, cand, ncand, &ks) == 0) {
+        bool rejected = (ks.p_value < args->alpha);
+        printf("\nKolmogorov-Smirnov: D = %.4f, p = %.3g -> %s at alpha = %.3g%s\n", ks.d, ks.p_value,
+            rejected ? "distributions differ" : "no significant difference", args->alpha,
+            (rejected && args->fail_on_ks) ? "  REGRESSION" : "");
+        if (rejected && args->fail_on_ks) {
+            regression = true;
+        }
+    }
+
+    free(base);
+    free(cand);
+    return regression ? EXIT_REGRESSION : EXIT_SUCCESS;
+}
+
+
+/**
+ * One row of a sweep report.
+ */
+typedef struct {
+    char        line[REPORT_LINE_MAX];
+    char*       fields[REPORT_MAX_COLUMNS];
+    size_t      num_fields;
+} report_row_t;
+
+typedef struct {
+    report_row_t    header;
+    report_row_t*   rows;
+    size_t          num_rows;
+} report_t;
+
+
+/**
+ * @brief Split a CSV line into fields in place.
+ */
+static void split_row(report_row_t* row) {
+    row->line[strcspn(row->line, "\r\n")] = '\0';
+    row->num_fields = 0;
+    char* p = row->line;
+    while (row->num_fields < REPORT_MAX_COLUMNS) {
+        row->fields[row->num_fields++] = p;
+        p = strchr(p, ',');
+        if (p == NULL) {
+            break;
+        }
+        *p++ = '\0';
+    }
+}
+
+
+static int column_index(const report_t* report, const char* name) {
+    for (size_t i = 0; i < report->header.num_fields; i++) {
+        if (strcmp(report->header.fields[i], name) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+
+/**
+ * @brief Load a report written by RPISignalSweep.
+ *
+ * @return int 0 on success, or -1 on failure.
+ */
+static int load_report(const char* filename, report_t* report) {
+    FILE* fp = fopen(filename, "r");
+    if (fp == NULL) {
+        perror(filename);
+        return -1;
+    }
+
+    report->rows = NULL;
+    report->num_rows = 0;
+    size_t capacity = 0;
+
+    if (fgets(report->header.line, REPORT_LINE_MAX, fp) == NULL) {
+        fclose(fp);
+        return -1;
+    }
+    split_row(&report->header);
+
+    report_row_t row;
+    while (fgets(row.line, REPORT_LINE_MAX, fp) != NULL) {
+        if (report->num_rows >= capacity) {
+            capacity = (capacity == 0) ? 16 : capacity * 2;
+            report_row_t* temp = realloc(report->rows, capacity * sizeof(report_row_t));
+            if (!temp) {
+                perror("realloc failed");
+                free(report->rows);
+                fclose(fp);
+                return -1;
+            }
+            report->rows = temp;
+        }
+        report_row_t* dst = &report->rows[report->num_rows++];
+        memcpy(dst->line, row.line, REPORT_LINE_MAX);
+        split_row(dst);
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+
+/**
+ * @brief Check whether a report row is complete and its cell ran successfully.
+ */
+static bool row_ok(const report_t* report, const report_row_t* row, int status_column) {
+    if (row->num_fields != report->header.num_fields) {
+        return false;
+    }
+    return status_column < 0 || strcmp(row->fields[status_column], "ok") == 0;
+}
+
+
+/**
+ * @brief Print the configuration of a sweep cell.
+ */
+static void print_cell(const report_row_t* row, const int* keys) {
+    printf("\n");
+    for (int k = 0; k < REPORT_KEY_COLUMNS; k++) {
+        if (keys[k] >= 0) {
+            printf("%s=%s ", key_columns[k], row->fields[keys[k]]);
+        }
+    }
+    printf("\n");
+}
+
+
+/**
+ * @brief Compare two sweep reports cell by cell.
+ *
+ * Only the summaries are available, so no distribution tests are done. A
+ * baseline cell that is missing or failed in the candidate is a regression.
+ *
+ * @return int Exit status.
+ */
+static int compare_reports(const compare_args_t* args, const char* base_file, const char* cand_file) {
+    report_t base, cand;
+    if (load_report(base_file, &base) != 0) {
+        return EXIT_ERROR;
+    }
+    if (load_report(cand_file, &cand) != 0) {
+        free(base.rows);
+        return EXIT_ERROR;
+    }
+
+    int base_keys[REPORT_KEY_COLUMNS], cand_keys[REPORT_KEY_COLUMNS];
+    int base_metrics[NUM_METRICS], cand_metrics[NUM_METRICS];
+    for (int k = 0; k < REPORT_KEY_COLUMNS; k++) {
+        base_keys[k] = column_index(&base, key_columns[k]);
+        cand_keys[k] = column_index(&cand, key_columns[k]);
+    }
+    for (int m = 0; m < NUM_METRICS; m++) {
+        base_metrics[m] = column_index(&base, metric_columns[m]);
+        cand_metrics[m] = column_index(&cand, metric_columns[m]);
+        if (base_metrics[m] < 0 || cand_metrics[m] < 0) {
+            fprintf(stderr, "Column %s missing in report\n", metric_columns[m]);
+            free(base.rows);
+            free(cand.rows);
+            return EXIT_ERROR;
+        }
+    }
+
+    int base_status = column_index(&base, "status");
+    int cand_status = column_index(&cand, "status");
+
+    bool regression = false;
+    size_t compared = 0, missing = 0;
+
+    for (size_t i = 0; i < base.num_rows; i++) {
+        report_row_t* b = &base.rows[i];
+
+        /* Find the candidate cell with the same configuration, missing key columns match anything */
+        report_row_t* c = NULL;
+        for (size_t j = 0; j < cand.num_rows && c == NULL; j++) {
+            bool match = true;
+            for (int k = 0; k < REPORT_KEY_COLUMNS && match; k++) {
+                if (base_keys[k] >= 0 && cand_keys[k] >= 0 &&
+                    strcmp(b->fields[base_keys[k]], cand.rows[j].fields[cand_keys[k]]) != 0) {
+                    match = false;
+                }
+            }
+            if (match) {
+                c = &cand.rows[j];
+            }
+        }
+
+        /* Nothing to compare against */
+        if (!row_ok(&base, b, base_status)) {
+            continue;
+        }
+
+        print_cell(b, base_keys);
+        if (c == NULL || !row_ok(&cand, c, cand_status)) {
+            printf("  %s in candidate  REGRESSION\n", (c == NULL) ? "missing" : "failed");
+            regression = true;
+            missing++;
+            continue;
+        }
+
+        printf("  %-6s %12s %12s %12s %9s\n", "metric", "baseline", "candidate", "delta", "");
+        for (int m = 0; m < NUM_METRICS; m++) {
+            regression |= check_metric(args, (metric_t)m,
+                strtoll(b->fields[base_metrics[m]], NULL, 10), strtoll(c->fields[cand_metrics[m]], NULL, 10));
+        }
+        compared++;
+    }
+
+    printf("\n%zu of %zu cells compared, %zu missing or failed in candidate\n", compared, base.num_rows, missing);
+
+    free(base.rows);
+    free(cand.rows);
+    if (compared == 0 && missing == 0) {
+        fprintf(stderr, "No matching cells in the two reports\n");
+        return EXIT_ERROR;
+    }
+    return regression ? EXIT_REGRESSION : EXIT_SUCCESS;
+}
+
+
+/**
+ * @brief Check whether a file is a report written by RPISignalSweep.
+ */
+static bool is_report(const char* filename) {
+    char line[16] = {0};
+    FILE* fp = fopen(filename, "r");
+    if (fp == NULL) {
+        return false;
+    }
+    bool report = (fgets(line, sizeof(line), fp) != NULL && strncmp(line, "kernel,", 7) == 0);
+    fclose(fp);
+    return report;
+}
+
+
+/**
+ * @brief Main.
+ */
+int main(int argc, char** argv) {
+    compare_args_t args = {
+        .expected_ns = 0,
+        .fail_on_ks = false,
+        .alpha = DEFAULT_ALPHA,
+        .bootstrap = DEFAULT_BOOTSTRAP,
+        .seed = 0,
+    };
+    for (int m = 0; m < NUM_METRICS; m++) {
+        args.threshold[m] = -1;
+    }
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:T:ka:B:s:h")) != -1) {
+        switch (opt) {
+            case 'f':
+                long freq = atol(optarg);
+                if (freq <= 0) {
+                    fprintf(stderr, "Invalid signal frequency\n");
+                    return EXIT_ERROR;
+                }
+                args.expected_ns = HALF_PERIOD_NS((uint64_t)freq);
+                break;
+
+            case 'T':
+                char* sep = strchr(optarg, ':');
+                int m;
+                for (m = 0; m < NUM_METRICS; m++) {
+                    if (sep != NULL && strncmp(optarg, metric_names[m], sep - optarg) == 0 &&
+                        strlen(metric_names[m]) == (size_t)(sep - optarg)) {
+                        break;
+                    }
+                }
+                if (m == NUM_METRICS || atoll(sep + 1) < 0) {
+                    fprintf(stderr, "Invalid threshold. Expected: <p50|p90|p99|p999|max>:<ns>\n");
+                    return EXIT_ERROR;
+                }
+                args.threshold[m] = atoll(sep + 1);
+                break;
+
+            case 'k': args.fail_on_ks = true; break;
+            case 'a': args.alpha = atof(optarg); break;
+            case 'B': args.bootstrap = (unsigned int)atoi(optarg); break;
+            case 's': args.seed = strtoull(optarg, NULL, 10); break;
+            case 'h':
+                print_help(argv[0]);
+                exit(EXIT_SUCCESS);
+            default:
+                fprintf(stderr, "Usage: %s [-h] <baseline> <candidate>\n", argv[0]);
+                return EXIT_ERROR;
+        }
+    }
+
+    if (argc - optind != 2) {
+        fprintf(stderr, "Usage: %s [-h] <baseline> <candidate>\n", argv[0]);
+        return EXIT_ERROR;
+    }
+
+    const char* base_file = argv[optind];
+    const char* cand_file = argv[optind + 1];
+
+    if (is_report(base_file) != is_report(cand_file)) {
+        fprintf(stderr, "Cannot compare a capture with a sweep report\n");
+        return EXIT_ERROR;
+    }
+
+    if (is_report(base_file)) {
+        return compare_reports(&args, base_file, cand_file);
+    }
+    return compare_captures(&args, base_file, cand_file);
+}
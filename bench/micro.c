@@ -0,0 +1,408 @@
+/**
+ * @file micro.c
+ *
+ * Component microbenchmarks for the building blocks of the signal generation
+ * hot path: ring buffer, clock sources and GPIO access. Every operation is
+ * warmed up and then timed individually (or in batches of BATCH_CHEAP for
+ * operations close to the counter resolution) with the CPU's cycle/tick
+ * counter. Median, p99, p99.9 and max per operation are reported, so the
+ * budget at 10-100 kHz can be accounted for line by line.
+ *
+ * On x86 the TSC is used, on aarch64 the generic timer (cntvct_el0, 54 MHz on
+ * the Raspberry Pi 4/5), elsewhere CLOCK_MONOTONIC_RAW. The counter frequency
+ * is calibrated against CLOCK_MONOTONIC_RAW. With a counter slower than 1 tick
+ * per ns (e.g. cntvct_el0 at ~18.5 ns per tick), operations of a few ticks are
+ * batched as well; their percentiles then describe batch averages.
+ *
+ * Example:
+ *   ./RPISignalMicro -c 1 -C 2 -d gpiochip4:26
+ *
+ */
+
+#include "../inc/main.h"
+#include "../inc/stats.h"
+
+#include <string.h>
+
+
+#define DEFAULT_ITERATIONS  100000          /* Timed iterations per benchmark */
+#define DEFAULT_WARMUP      10000           /* Untimed iterations before each benchmark */
+#define BATCH_CHEAP         64              /* Operations per timed batch for very cheap operations */
+#define CALIBRATION_NS      200000000UL     /* Duration of the counter calibration */
+
+
+typedef void (*bench_fn_t)(void* ctx);
+
+typedef struct {
+    unsigned int    iterations;
+    unsigned int    warmup;
+    int             core_id;
+    int             consumer_core;
+    const char*     device;
+} micro_args_t;
+
+/* Counter ticks per ns, set by calibrate_counter() */
+static double ticks_per_ns = 1.0;
+
+/* Counter overhead of one timed measurement in ticks, set by calibrate_counter() */
+static uint64_t counter_overhead = 0;
+
+
+/**
+ * @brief Read the CPU's cycle/tick counter, serialized against earlier instructions.
+ */
+static inline uint64_t read_counter(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    uint32_t lo, hi;
+    __asm__ volatile("lfence\n\trdtsc" : "=a"(lo), "=d"(hi) :: "memory");
+    return ((uint64_t)hi << 32) | lo;
+#elif defined(__aarch64__)
+    uint64_t val;
+    __asm__ volatile("isb\n\tmrs %0, cntvct_el0" : "=r"(val) :: "memory");
+    return val;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * SEC_IN_NS + ts.tv_nsec;
+#endif
+}
+
+
+static int compare_int64(const void* a, const void* b) {
+    int64_t x = *(const int64_t*)a;
+    int64_t y = *(const int64_t*)b;
+    return (x > y) - (x < y);
+}
+
+
+/**
+ * @brief Determine the counter frequency and the overhead of an empty measurement.
+ */
+static void calibrate_counter(void) {
+    struct timespec start, now;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+    uint64_t c0 = read_counter();
+    do {
+        clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+    } while (timespec_delta_nanoseconds(&now, &start) < CALIBRATION_NS);
+    uint64_t c1 = read_counter();
+    ticks_per_ns = (double)(c1 - c0) / (double)timespec_delta_nanoseconds(&now, &start);
+
+    uint64_t min = UINT64_MAX;
+    for (int i = 0; i < DEFAULT_WARMUP; i++) {
+        uint64_t t0 = read_counter();
+        uint64_t t1 = read_counter();
+        if (t1 - t0 < min) {
+            min = t1 - t0;
+        }
+    }
+    counter_overhead = min;
+
+    printf("Counter: %.3f ticks/ns, overhead %" PRIu64 " ticks\n\n", ticks_per_ns, counter_overhead);
+    printf("%-36s %10s %10s %10s %10s   (ns per operation)\n", "benchmark", "median", "p99", "p99.9", "max");
+}
+
+
+/**
+ * @brief Batch size for an operation of a few ns: 1 with a cycle-accurate counter, BATCH_CHEAP otherwise.
+ */
+static unsigned int batch_fast(void) {
+    return (ticks_per_ns < 1.0) ? BATCH_CHEAP : 1;
+}
+
+
+/**
+ * @brief Print one result line from per-operation samples in ticks. Sorts the samples.
+ */
+static void report(const char* name, int64_t* samples, size_t count, unsigned int batch) {
+    qsort(samples, count, sizeof(int64_t), compare_int64);
+
+    double scale = 1.0 / (ticks_per_ns * batch);
+    printf("%-36s %10.1f %10.1f %10.1f %10.1f\n", name,
+        stats_percentile(samples, count, 50.0) * scale,
+        stats_percentile(samples, count, 99.0) * scale,
+        stats_percentile(samples, count, 99.9) * scale,
+        samples[count - 1] * scale);
+}
+
+
+/**
+ * @brief Warm up and time an operation, executing it <batch> times per measurement.
+ */
+static void bench_run(const char* name, bench_fn_t fn, void* ctx, unsigned int batch, const micro_args_t* args) {
+    int64_t* samples = malloc(args->iterations * sizeof(int64_t));
+    if (!samples) {
+        perror("malloc failed");
+        return;
+    }
+
+    for (unsigned int i = 0; i < args->warmup; i++) {
+        fn(ctx);
+    }
+
+    for (unsigned int i = 0; i < args->iterations; i++) {
+        uint64_t t0 = read_counter();
+        for (unsigned int b = 0; b < batch; b++) {
+            fn(ctx);
+        }
+        uint64_t t1 = read_counter();
+        uint64_t ticks = t1 - t0;
+        samples[i] = (ticks > counter_overhead) ? (int64_t)(ticks - counter_overhead) : 0;
+    }
+
+    report(name, samples, args->iterations, batch);
+    free(samples);
+}
+
+
+/**
+ * Ring buffer
+ */
+
+typedef struct {
+    ring_buffer_t   rb;
+    uint64_t        value;
+    volatile bool   stop;
+    int             core_id;
+} ring_ctx_t;
+
+static void op_ring_queue(void* ctx) {
+    ring_ctx_t* r = ctx;
+    WRITE_TO_RINGBUFFER(&r->rb, r->value);
+    r->value++;
+}
+
+static void op_ring_queue_dequeue(void* ctx) {
+    ring_ctx_t* r = ctx;
+    uint64_t out;
+    WRITE_TO_RINGBUFFER(&r->rb, r->value);
+    ring_buffer_dequeue_arr(&r->rb, (char*)&out, sizeof(uint64_t));
+    r->value = out + 1;
+}
+
+static void op_aggregate_sample(void* ctx) {
+    static aggregate_t agg;
+    ring_ctx_t* r = ctx;
+    if (agg.expected_ns == 0) {
+        aggregate_init(&agg, HALF_PERIOD_NS(MAX_SIGNAL_FREQ), DEADLINE_TOLERANCE_NS);
+    }
+    /* Spread the intervals over a few hundred buckets around the expected value */
+    aggregate_sample(&agg, &r->rb, agg.expected_ns - 2048 + ((r->value * 2654435761ULL) & 4095));
+    r->value++;
+}
+
+static void* ring_consumer(void* args) {
+    ring_ctx_t* r = args;
+    uint64_t out;
+    stick_thread_to_core(r->core_id);
+    while (!r->stop) {
+        ring_buffer_dequeue_arr(&r->rb, (char*)&out, sizeof(uint64_t));
+    }
+    return NULL;
+}
+
+static void bench_ring(const micro_args_t* args) {
+    size_t buffer_size = RING_BUFFER_SIZE * sizeof(uint64_t);
+    char* buffer = malloc(buffer_size);
+    if (!buffer) {
+        perror("malloc failed");
+        return;
+    }
+
+    ring_ctx_t r = { .value = 0, .stop = false, .core_id = args->consumer_core };
+
+    /* Uncontended: queue and dequeue on the same core, the ring never fills */
+    ring_buffer_init(&r.rb, buffer, buffer_size);
+    bench_run("ring_buffer_queue_arr+dequeue_arr", op_ring_queue_dequeue, &r, batch_fast(), args);
+
+    /* Contended: consumer drains the ring on another core while the producer queues */
+    ring_buffer_init(&r.rb, buffer, buffer_size);
+    pthread_t consumer;
+    if (pthread_create(&consumer, NULL, ring_consumer, &r) != 0) {
+        fprintf(stderr, "Error spawning consumer thread\n");
+        free(buffer);
+        return;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "ring_buffer_queue_arr (consumer@%d)", args->consumer_core);
+    bench_run(name, op_ring_queue, &r, batch_fast(), args);
+    snprintf(name, sizeof(name), "aggregate_sample (consumer@%d)", args->consumer_core);
+    bench_run(name, op_aggregate_sample, &r, batch_fast(), args);
+
+    r.stop = true;
+    pthread_join(consumer, NULL);
+    free(buffer);
+}
+
+
+/**
+ * Clocks
+ */
+
+typedef struct {
+    clockid_t       clock;
+    struct timespec a;
+    struct timespec b;
+    volatile uint64_t sink;
+} clock_ctx_t;
+
+static void op_clock_gettime(void* ctx) {
+    clock_ctx_t* c = ctx;
+    clock_gettime(c->clock, &c->a);
+}
+
+static void op_timespec_delta(void* ctx) {
+    clock_ctx_t* c = ctx;
+    c->sink += timespec_delta_nanoseconds(&c->b, &c->a);
+    c->b.tv_nsec ^= 1;
+}
+
+static void bench_clocks(const micro_args_t* args) {
+    static const struct {
+        clockid_t   id;
+        const char* name;
+    } clocks[] = {
+        { CLOCK_MONOTONIC,          "clock_gettime(MONOTONIC)" },
+        { CLOCK_MONOTONIC_RAW,      "clock_gettime(MONOTONIC_RAW)" },
+        { CLOCK_MONOTONIC_COARSE,   "clock_gettime(MONOTONIC_COARSE)" },
+        { CLOCK_REALTIME,           "clock_gettime(REALTIME)" },
+        { CLOCK_TAI,                "clock_gettime(TAI)" },
+        { CLOCK_BOOTTIME,           "clock_gettime(BOOTTIME)" },
+    };
+
+    clock_ctx_t c = { .sink = 0 };
+    for (size_t i = 0; i < sizeof(clocks) / sizeof(clocks[0]); i++) {
+        c.clock = clocks[i].id;
+        bench_run(clocks[i].name, op_clock_gettime, &c, batch_fast(), args);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &c.a);
+    clock_gettime(CLOCK_MONOTONIC, &c.b);
+    bench_run("timespec_delta_nanoseconds", op_timespec_delta, &c, BATCH_CHEAP, args);
+}
+
+
+/**
+ * GPIO
+ */
+
+typedef struct {
+    gpio_handle_t*  gpio;
+    int             value;
+} gpio_ctx_t;
+
+static void op_gpiod_set_value(void* ctx) {
+    gpio_ctx_t* g = ctx;
+    g->value ^= 1;
+    gpiod_line_set_value(g->gpio->line, g->value);
+}
+
+static void op_gpiod_get_value(void* ctx) {
+    gpio_ctx_t* g = ctx;
+    g->value = gpiod_line_get_value(g->gpio->line);
+}
+
+static void bench_gpio(const micro_args_t* args) {
+    gpio_handle_t* gpio;
+
+    if (args->device != NULL) {
+        if (strlen(args->device) >= 13 || strlen(args->device) < 11 || args->device[9] != ':') {
+            fprintf(stderr, "Invalid GPIO Chip. Expected Format: gpiochipX:XX\n");
+            return;
+        }
+        char gpio_chip[16] = "/dev/";
+        strncpy(gpio_chip + 5, args->device, 9);
+        gpio_chip[14] = '\0';
+        gpio = init_gpio(atoi(args->device + 10), gpio_chip);
+    } else {
+        gpio = init_gpio(GPIO_PIN, GPIO_CHIP);
+    }
+
+    if (gpio == NULL) {
+        fprintf(stderr, "GPIO not available, skipping GPIO benchmarks\n");
+        return;
+    }
+
+    gpio_ctx_t g = { .gpio = gpio, .value = 0 };
+    bench_run("gpiod_line_set_value (libgpiod v1)", op_gpiod_set_value, &g, 1, args);
+    bench_run("gpiod_line_get_value (libgpiod v1)", op_gpiod_get_value, &g, 1, args);
+
+    gpiod_chip_close(gpio->chip);
+    free(gpio);
+}
+
+
+/**
+ * @brief Print help message for command line arguments.
+ */
+static void print_help(const char* progname) {
+    printf("Usage: %s [options]\n", progname);
+    printf("Options:\n");
+    printf("  -c <cpu core>\t\tCPU core to run the benchmarks on (default %d)\n", CPU_CORE);
+    printf("  -C <cpu core>\t\tCPU core of the ring buffer consumer (default next core)\n");
+    printf("  -p <priority>\t\tSCHED_FIFO priority of the benchmark thread\n");
+    printf("  -n <iterations>\tTimed iterations per benchmark (default %d)\n", DEFAULT_ITERATIONS);
+    printf("  -w <iterations>\tWarm-up iterations per benchmark (default %d)\n", DEFAULT_WARMUP);
+    printf("  -d <gpiochipX:XX>\tGPIO Chip and Pin for the GPIO benchmarks (default from config.h)\n");
+    printf("  -G \t\t\tSkip the GPIO benchmarks\n");
+    printf("  -h \t\t\tShow this help message\n");
+}
+
+
+/**
+ * @brief Main.
+ */
+int main(int argc, char** argv) {
+    micro_args_t args = {
+        .iterations = DEFAULT_ITERATIONS,
+        .warmup = DEFAULT_WARMUP,
+        .core_id = CPU_CORE,
+        .consumer_core = -1,
+        .device = NULL,
+    };
+    int sched_prio = 0;
+    bool skip_gpio = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:C:p:n:w:d:Gh")) != -1) {
+        switch (opt) {
+            case 'c': args.core_id = atoi(optarg); break;
+            case 'C': args.consumer_core = atoi(optarg); break;
+            case 'p': sched_prio = atoi(optarg); break;
+            case 'n': args.iterations = (unsigned int)atoi(optarg); break;
+            case 'w': args.warmup = (unsigned int)atoi(optarg); break;
+            case 'd': args.device = optarg; break;
+            case 'G': skip_gpio = true; break;
+            case 'h':
+                print_help(argv[0]);
+                exit(EXIT_SUCCESS);
+            default:
+                fprintf(stderr, "Usage: %s [-h]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (args.iterations == 0) {
+        fprintf(stderr, "Iterations must be > 0\n");
+        return EXIT_FAILURE;
+    }
+    if (args.consumer_core < 0) {
+        args.consumer_core = (args.core_id + 1) % sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+    stick_thread_to_core(args.core_id);
+    if (sched_prio >= 1) {
+        set_thread_priority(sched_prio);
+    }
+
+    calibrate_counter();
+    bench_ring(&args);
+    bench_clocks(&args);
+    if (!skip_gpio) {
+        bench_gpio(&args);
+    }
+
+    return EXIT_SUCCESS;
+}
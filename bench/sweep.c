@@ -0,0 +1,463 @@
+/**
+ * @file sweep.c
+ *
+ * End-to-end jitter benchmark sweep, similar to running cyclictest over a
+ * matrix of configurations. Every cell of the matrix (wait mode x frequency x
+ * priority x core x GPIO device x background load) runs RPISignal for a fixed
+ * duration or sample count. The warm-up of each cell is discarded, the
+ * remaining intervals are evaluated and collected, together with CPU time and
+ * context switches of the signal generation thread, into one CSV report plus a comparison table
+ * on stdout. The per-cell captures are written to a temporary directory and
+ * removed after evaluation.
+ *
+ * Example:
+ *   ./RPISignalSweep -w block,poll -f 100,1000 -p 0,80 -c 1 -l none,mem+io -t 30 -W 2 -o report.csv
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <sys/resource.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+
+#include "../inc/config.h"
+#include "../inc/stats.h"
+
+
+#define SEC_IN_NS           1000000000UL
+#define HALF_PERIOD_NS(freq)     (SEC_IN_NS / ( 2 * freq ))
+#define MAX_SIGNAL_FREQ     10000           /* Same limit as RPISignal (main.h), above it RPISignal silently runs at its default */
+#define MAX_SCHED_PRIO      99              /* Same limit as RPISignal, prio and core out of range also fall back to defaults */
+
+#define MAX_LIST_ITEMS      16              /* Max. values per matrix dimension */
+#define WARMUP_CLEAN        100             /* Consecutive overrun-free intervals that end the warm-up */
+
+#define DEFAULT_BINARY      "./RPISignal"
+#define DEFAULT_REPORT      "sweep_report.csv"
+#define DEFAULT_DURATION    10              /* Measurement duration per cell in seconds */
+#define DEFAULT_WARMUP      1               /* Warm-up per cell in seconds */
+#define TMPDIR_TEMPLATE     "/tmp/rpisignal_sweep_XXXXXX"
+
+
+typedef struct {
+    char*   items[MAX_LIST_ITEMS];
+    size_t  count;
+} list_t;
+
+typedef struct {
+    const char*     binary;
+    const char*     report;
+    const char*     tmpdir;                 /* Directory of the per-cell captures */
+    list_t          wait_modes;
+    list_t          freqs;
+    list_t          prios;
+    list_t          cores;
+    list_t          devices;
+    list_t          loads;
+    unsigned int    duration_s;
+    unsigned int    warmup_s;
+    uint64_t        samples;
+} sweep_args_t;
+
+typedef struct {
+    const char*     wait_mode;
+    const char*     freq;
+    const char*     prio;
+    const char*     core;
+    const char*     device;
+    const char*     load;
+    jitter_stats_t  stats;
+    int             warmup_ok;
+    double          utime_ms;
+    double          stime_ms;
+    long            nvcsw;
+    long            nivcsw;
+    int             has_usage;              /* CPU usage columns valid, see read_gen_usage() */
+    int             valid;
+} cell_result_t;
+
+
+/**
+ * @brief Split a comma separated argument into a list. Modifies the argument.
+ */
+static void parse_list(char* arg, list_t* list) {
+    list->count = 0;
+    for (char* tok = strtok(arg, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        if (list->count >= MAX_LIST_ITEMS) {
+            fprintf(stderr, "Too many values in list, max. %d\n", MAX_LIST_ITEMS);
+            exit(EXIT_FAILURE);
+        }
+        list->items[list->count++] = tok;
+    }
+}
+
+
+/**
+ * @brief Print help message for command line arguments.
+ */
+static void print_help(const char* progname) {
+    printf("Usage: %s [options]\n", progname);
+    printf("Options (lists are comma separated):\n");
+    printf("  -x <path>\t\tRPISignal binary (default %s)\n", DEFAULT_BINARY);
+    printf("  -w <modes>\t\tWait modes: block,poll\n");
+    printf("  -f <freqs>\t\tSignal frequencies in Hz\n");
+    printf("  -p <prios>\t\tPriorities of the signal generation thread\n");
+    printf("  -c <cores>\t\tCPU cores to execute signal generation on\n");
+    printf("  -d <devices>\t\tGPIO devices gpiochipX:XX (default from config.h)\n");
+    printf("  -l <loads>\t\tBackground loads, types joined by '+': none,mem,syscall+io,io:<dir>,all\n");
+    printf("  -t <seconds>\t\tMeasurement duration per cell (default %d)\n", DEFAULT_DURATION);
+    printf("  -n <samples>\t\tMeasured samples per cell, overrides -t\n");
+    printf("  -W <seconds>\t\tWarm-up per cell, discarded (default %d)\n", DEFAULT_WARMUP);
+    printf("  -o <filename>\t\tMachine-readable report (default %s)\n", DEFAULT_REPORT);
+    printf("  -h \t\t\tShow this help message\n");
+}
+
+
+/**
+ * @brief Read the CPU usage of the signal generation thread from the output of RPISignal.
+ *
+ * @return int 0 on success, or -1 if the output has no usage line.
+ */
+static int read_gen_usage(const char* log, cell_result_t* res) {
+    FILE* fp = fopen(log, "r");
+    if (fp == NULL) {
+        return -1;
+    }
+
+    char line[256];
+    int ret = -1;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (sscanf(line, GEN_USAGE_SCAN, &res->utime_ms, &res->stime_ms, &res->nvcsw, &res->nivcsw) == 4) {
+            ret = 0;
+        }
+    }
+    fclose(fp);
+    return ret;
+}
+
+
+/**
+ * @brief Run one cell of the matrix and evaluate its intervals.
+ *
+ * @return int 0 on success, or -1 on failure.
+ */
+static int run_cell(const sweep_args_t* args, size_t index, cell_result_t* res) {
+    long freq = atol(res->freq);
+    if (freq <= 0 || freq > MAX_SIGNAL_FREQ) {
+        fprintf(stderr, "Invalid frequency: %s (1..%d Hz)\n", res->freq, MAX_SIGNAL_FREQ);
+        return -1;
+    }
+    long prio = atol(res->prio);
+    if (prio < 0 || prio > MAX_SCHED_PRIO) {
+        fprintf(stderr, "Invalid priority: %s (0..%d)\n", res->prio, MAX_SCHED_PRIO);
+        return -1;
+    }
+    long core = atol(res->core);
+    long num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (core < 0 || core >= num_cores) {
+        fprintf(stderr, "Invalid core: %s (0..%ld)\n", res->core, num_cores - 1);
+        return -1;
+    }
+
+    char csv[128], log[128];
+    snprintf(csv, sizeof(csv), "%s/sweep_%03zu.csv", args->tmpdir, index);
+    snprintf(log, sizeof(log), "%s/sweep_%03zu.log", args->tmpdir, index);
+    uint64_t half_period_ns = HALF_PERIOD_NS((uint64_t)freq);
+
+    /* Two toggles per period, one interval per toggle */
+    unsigned int measure_s = args->duration_s;
+    if (args->samples > 0) {
+        measure_s = (unsigned int)((args->samples + 2 * freq - 1) / (2 * freq));
+    }
+    char duration[16];
+    snprintf(duration, sizeof(duration), "%u", args->warmup_s + measure_s);
+
+    /* RPISignal expects the load types comma separated */
+    char load[64];
+    snprintf(load, sizeof(load), "%s", res->load);
+    for (char* c = load; *c != '\0'; c++) {
+        if (*c == '+') {
+            *c = ',';
+        }
+    }
+
+    char* argv[24];
+    int argc = 0;
+    argv[argc++] = (char*)args->binary;
+    argv[argc++] = "-w"; argv[argc++] = (char*)res->wait_mode;
+    argv[argc++] = "-f"; argv[argc++] = (char*)res->freq;
+    argv[argc++] = "-p"; argv[argc++] = (char*)res->prio;
+    argv[argc++] = "-c"; argv[argc++] = (char*)res->core;
+    if (res->device != NULL) {
+        argv[argc++] = "-d"; argv[argc++] = (char*)res->device;
+    }
+    if (strcmp(load, "none") != 0) {
+        argv[argc++] = "-L"; argv[argc++] = load;
+    }
+    argv[argc++] = "-D"; argv[argc++] = duration;
+    argv[argc++] = "-o"; argv[argc++] = csv;
+    argv[argc] = NULL;
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed");
+        return -1;
+    }
+    if (pid == 0) {
+        int devnull = open("/dev/null", O_RDWR);
+        if (devnull >= 0) {
+            dup2(devnull, STDIN_FILENO);
+            close(devnull);
+        }
+        int logfd = open(log, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        if (logfd >= 0) {
+            dup2(logfd, STDOUT_FILENO);
+            close(logfd);
+        }
+        execv(args->binary, argv);
+        perror("execv failed");
+        _exit(127);
+    }
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        perror("wait4 failed");
+        return -1;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "Cell %zu: RPISignal failed\n", index);
+        unlink(csv);
+        unlink(log);
+        return -1;
+    }
+
+    /*
+     * Prefer the usage of the generator thread. The process usage of wait4()
+     * includes the stressor threads, it is only used for cells without load.
+     */
+    res->has_usage = (read_gen_usage(log, res) == 0);
+    unlink(log);
+    if (!res->has_usage && strcmp(load, "none") == 0) {
+        res->utime_ms = usage.ru_utime.tv_sec * 1e3 + usage.ru_utime.tv_usec / 1e3;
+        res->stime_ms = usage.ru_stime.tv_sec * 1e3 + usage.ru_stime.tv_usec / 1e3;
+        res->nvcsw = usage.ru_nvcsw;
+        res->nivcsw = usage.ru_nivcsw;
+        res->has_usage = 1;
+    }
+
+    uint64_t* diffs = NULL;
+    size_t count = 0;
+    int loaded = stats_load_csv(csv, &diffs, &count);
+    unlink(csv);
+    if (loaded != 0) {
+        return -1;
+    }
+
+    /* Discard the warm-up, then wait for WARMUP_CLEAN consecutive overrun-free intervals */
+    size_t start = (size_t)args->warmup_s * 2 * freq;
+    size_t clean = 0;
+    while (start < count && clean < WARMUP_CLEAN) {
+        clean = (diffs[start] > half_period_ns + DEADLINE_TOLERANCE_NS) ? 0 : clean + 1;
+        start++;
+    }
+    res->warmup_ok = (clean >= WARMUP_CLEAN);
+
+    size_t end = count;
+    if (args->samples > 0 && start + args->samples < end) {
+        end = start + args->samples;
+    }
+
+    int ret = stats_compute(diffs + start, end - start, half_period_ns, DEADLINE_TOLERANCE_NS, &res->stats);
+    free(diffs);
+    if (ret != 0) {
+        fprintf(stderr, "Cell %zu: no samples after warm-up\n", index);
+        return -1;
+    }
+
+    res->valid = 1;
+    return 0;
+}
+
+
+/**
+ * @brief Write all cells as CSV, one line per cell.
+ */
+static int write_report(const char* filename, const cell_result_t* cells, size_t num) {
+    FILE* fp = fopen(filename, "w");
+    if (fp == NULL) {
+        perror(filename);
+        return -1;
+    }
+
+    struct utsname uts;
+    uname(&uts);
+    int realtime = (access("/sys/kernel/realtime", F_OK) == 0);
+
+    fprintf(fp, "kernel,rt,wait,freq,prio,core,device,load,status,samples,warmup_ok,"
+                "min_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns,max_abs_ns,mean_ns,stddev_ns,overruns,"
+                "utime_ms,stime_ms,nvcsw,nivcsw\n");
+
+    for (size_t i = 0; i < num; i++) {
+        const cell_result_t* c = &cells[i];
+        if (!c->valid) {
+            /* Keep failed cells, so a comparison against this report sees them */
+            fprintf(fp, "%s,%d,%s,%s,%s,%s,%s,%s,failed,,,,,,,,,,,,,,,,\n",
+                uts.release, realtime, c->wait_mode, c->freq, c->prio, c->core,
+                c->device ? c->device : "default", c->load);
+            continue;
+        }
+        fprintf(fp, "%s,%d,%s,%s,%s,%s,%s,%s,ok,%zu,%d,"
+                    "%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64 ",%.1f,%.1f,%zu,",
+            uts.release, realtime, c->wait_mode, c->freq, c->prio, c->core,
+            c->device ? c->device : "default", c->load, c->stats.count, c->warmup_ok,
+            c->stats.min, c->stats.p50, c->stats.p90, c->stats.p99, c->stats.p999, c->stats.max,
+            c->stats.max_abs, c->stats.mean, c->stats.stddev, c->stats.overruns);
+        /* Empty if only the process usage, including the stressors, is known */
+        if (c->has_usage) {
+            fprintf(fp, "%.1f,%.1f,%ld,%ld\n", c->utime_ms, c->stime_ms, c->nvcsw, c->nivcsw);
+        } else {
+            fprintf(fp, ",,,\n");
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+
+/**
+ * @brief Print a comparison table of all cells to stdout.
+ */
+static void print_table(const cell_result_t* cells, size_t num) {
+    printf("\n%-6s %7s %4s %4s %-14s %-12s %9s %9s %9s %9s %9s %8s %9s %9s\n",
+        "wait", "freq", "prio", "core", "device", "load", "samples",
+        "p50", "p99", "p99.9", "max|abs|", "overrun", "cpu(ms)", "ctxsw");
+    for (size_t i = 0; i < num; i++) {
+        const cell_result_t* c = &cells[i];
+        if (!c->valid) {
+            printf("%-6s %7s %4s %4s %-14s %-12s %9s\n", c->wait_mode, c->freq, c->prio, c->core,
+                c->device ? c->device : "default", c->load, "failed");
+            continue;
+        }
+        char cpu[16] = "-", ctxsw[16] = "-";
+        if (c->has_usage) {
+            snprintf(cpu, sizeof(cpu), "%.0f", c->utime_ms + c->stime_ms);
+            snprintf(ctxsw, sizeof(ctxsw), "%ld", c->nvcsw + c->nivcsw);
+        }
+        printf("%-6s %7s %4s %4s %-14s %-12s %9zu %9" PRId64 " %9" PRId64 " %9" PRId64 " %9" PRId64 " %8zu %9s %9s%s\n",
+            c->wait_mode, c->freq, c->prio, c->core, c->device ? c->device : "default", c->load,
+            c->stats.count, c->stats.p50, c->stats.p99, c->stats.p999, c->stats.max_abs,
+            c->stats.overruns, cpu, ctxsw, c->warmup_ok ? "" : " (warm-up not overrun-free)");
+    }
+}
+
+
+/**
+ * @brief Main.
+ */
+int main(int argc, char** argv) {
+    static char default_wait[] = "block";
+    static char default_freq[] = "1000";
+    static char default_prio[] = "0";
+    static char default_core[] = "1";
+    static char default_load[] = "none";
+
+    sweep_args_t args = {
+        .binary = DEFAULT_BINARY,
+        .report = DEFAULT_REPORT,
+        .duration_s = DEFAULT_DURATION,
+        .warmup_s = DEFAULT_WARMUP,
+        .samples = 0,
+    };
+    parse_list(default_wait, &args.wait_modes);
+    parse_list(default_freq, &args.freqs);
+    parse_list(default_prio, &args.prios);
+    parse_list(default_core, &args.cores);
+    parse_list(default_load, &args.loads);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "x:w:f:p:c:d:l:t:n:W:o:h")) != -1) {
+        switch (opt) {
+            case 'x': args.binary = optarg; break;
+            case 'w': parse_list(optarg, &args.wait_modes); break;
+            case 'f': parse_list(optarg, &args.freqs); break;
+            case 'p': parse_list(optarg, &args.prios); break;
+            case 'c': parse_list(optarg, &args.cores); break;
+            case 'd': parse_list(optarg, &args.devices); break;
+            case 'l': parse_list(optarg, &args.loads); break;
+            case 't': args.duration_s = (unsigned int)atoi(optarg); break;
+            case 'n': args.samples = strtoull(optarg, NULL, 10); break;
+            case 'W': args.warmup_s = (unsigned int)atoi(optarg); break;
+            case 'o': args.report = optarg; break;
+            case 'h':
+                print_help(argv[0]);
+                exit(EXIT_SUCCESS);
+            default:
+                fprintf(stderr, "Usage: %s [-h]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (args.duration_s == 0 && args.samples == 0) {
+        fprintf(stderr, "Duration or sample count must be > 0\n");
+        return EXIT_FAILURE;
+    }
+
+    /* An empty device list runs RPISignal with its default GPIO from config.h */
+    size_t num_devices = (args.devices.count > 0) ? args.devices.count : 1;
+    size_t num = args.wait_modes.count * args.freqs.count * args.prios.count
+               * args.cores.count * num_devices * args.loads.count;
+
+    cell_result_t* cells = calloc(num, sizeof(cell_result_t));
+    if (!cells) {
+        perror("calloc failed");
+        return EXIT_FAILURE;
+    }
+
+    char tmpdir[] = TMPDIR_TEMPLATE;
+    if (mkdtemp(tmpdir) == NULL) {
+        perror("mkdtemp failed");
+        free(cells);
+        return EXIT_FAILURE;
+    }
+    args.tmpdir = tmpdir;
+
+    size_t index = 0;
+    for (size_t w = 0; w < args.wait_modes.count; w++)
+    for (size_t f = 0; f < args.freqs.count; f++)
+    for (size_t p = 0; p < args.prios.count; p++)
+    for (size_t c = 0; c < args.cores.count; c++)
+    for (size_t d = 0; d < num_devices; d++)
+    for (size_t l = 0; l < args.loads.count; l++) {
+        cell_result_t* res = &cells[index];
+        res->wait_mode = args.wait_modes.items[w];
+        res->freq = args.freqs.items[f];
+        res->prio = args.prios.items[p];
+        res->core = args.cores.items[c];
+        res->device = (args.devices.count > 0) ? args.devices.items[d] : NULL;
+        res->load = args.loads.items[l];
+
+        printf("[%zu/%zu] wait=%s freq=%s prio=%s core=%s device=%s load=%s\n", index + 1, num,
+            res->wait_mode, res->freq, res->prio, res->core, res->device ? res->device : "default", res->load);
+        fflush(stdout);
+
+        run_cell(&args, index, res);
+        index++;
+    }
+
+    rmdir(tmpdir);
+
+    int ret = write_report(args.report, cells, num);
+    print_table(cells, num);
+
+    free(cells);
+    return (ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,101 @@
+/**
+ * @file capture.h
+ * @brief Edge input-capture / loopback mode.
+ *
+ * A second GPIO line, wired to the output pin (or provided by gpio-sim), is
+ * requested for edge events. The kernel timestamps of these events are read
+ * in batches and correlated with the software timestamps and the intended
+ * (ideal) edge times of the signal generator. This yields the true output-edge
+ * jitter and the software-to-pin latency without an oscilloscope.
+ *
+ * The kernel timestamps edge events with CLOCK_MONOTONIC, so capture requires
+ * the edge schedule to run on CLOCK_MONOTONIC as well (-K mono, the default).
+ */
+
+#pragma once
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "main.h"
+
+#define CAPTURE_BATCH_SIZE      16          /* Max. events per gpiod_line_event_read_multiple() (GPIOEVENT_MAX) */
+#define CAPTURE_RING_BYTES      65536       /* Size of the software edge ring buffer, must be a power of two */
+#define CAPTURE_WAIT_MS         100         /* Timeout for waiting on edge events, bounds the reaction to the killswitch */
+
+/* Helper Macro */
+#define WRITE_EDGE_TO_RINGBUFFER(rbuffer, edge) \
+        (ring_buffer_queue_arr(rbuffer, (char*)&edge, sizeof(capture_edge_t)))
+
+/**
+ * A single edge, either set in software or observed by the kernel.
+ */
+typedef struct {
+    int64_t     ts_ns;                      /* CLOCK_MONOTONIC timestamp in ns */
+    int64_t     ideal_ns;                   /* Intended edge time (software edges only) */
+    int         value;                      /* New line level (0 or 1) */
+} capture_edge_t;
+
+/**
+ * A kernel-observed edge correlated with the generator.
+ */
+typedef struct {
+    uint64_t    edge;                       /* Edge number relative to the first intended edge */
+    int64_t     kernel_ts_ns;               /* Kernel timestamp of the edge */
+    int64_t     phase_err_ns;               /* Kernel timestamp minus intended edge time, INT64_MIN if unmatched */
+    int64_t     latency_ns;                 /* Kernel timestamp minus software timestamp, INT64_MIN if unmatched */
+} capture_sample_t;
+
+struct capture_t {
+    gpio_handle_t*      gpio;               /* Input line requested for both edge events */
+    ring_buffer_t       sw_ring;            /* Software edges pushed by the signal generator */
+    char*               sw_ring_buf;
+    uint64_t            half_period_ns;
+
+    capture_edge_t*     kernel_edges;       /* Edges read from the kernel */
+    size_t              kernel_count;
+    size_t              kernel_capacity;
+
+    capture_edge_t*     sw_edges;           /* Software edges drained from sw_ring */
+    size_t              sw_count;
+    size_t              sw_capacity;
+};
+
+
+/**
+ * Function declarations
+ */
+
+extern capture_t* capture_init(const char* device, uint64_t half_period_ns);
+extern void capture_free(capture_t* cap);
+extern void* func_capture(void* args);
+extern int capture_report(capture_t* cap, const char* filename);
+
+
+/**
+ * @brief Hand the software timestamp and the intended time of an edge to the capture thread.
+ *
+ * Call this from the signal generation thread with the timestamp taken
+ * immediately before gpiod_line_set_value(). Does nothing if capture is disabled.
+ *
+ * @param cap The capture context, may be NULL.
+ * @param ts CLOCK_MONOTONIC timestamp taken before the line was set.
+ * @param deadline Intended time of the edge, e.g. from schedule_next().
+ * @param value The new line level.
+ */
+static inline void capture_edge(capture_t* cap, const struct timespec* ts, const struct timespec* deadline, int value) {
+    if (cap == NULL) {
+        return;
+    }
+    capture_edge_t edge = {
+        .ts_ns = (int64_t)ts->tv_sec * (int64_t)SEC_IN_NS + ts->tv_nsec,
+        .ideal_ns = (int64_t)deadline->tv_sec * (int64_t)SEC_IN_NS + deadline->tv_nsec,
+        .value = value,
+    };
+    /* The ring buffer drops bytes when full, only queue complete edges */
+    if (RING_BUFFER_MASK((&cap->sw_ring)) - ring_buffer_num_items(&cap->sw_ring) >= sizeof(capture_edge_t)) {
+        WRITE_EDGE_TO_RINGBUFFER(&cap->sw_ring, edge);
+    }
+}
+
+#endif
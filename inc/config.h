@@ -12,6 +12,12 @@
 #define CPU_CORE        0                   /* Default CPU Core to execute signal generation on */
 #define SCHED_PRIO      0                   /* Default priority of the signal generation Thread: 1 lowest / 99 highest. If 0 -> disabled */
 #define SIGNAL_FREQ     10                  /* Default target signal frequency*/
+#define WAIT_MODE       WAIT_BLOCKING       /* Default wait strategy: WAIT_BLOCKING or WAIT_POLLING */
+#define SCHEDULE_CLOCK  CLOCK_MONOTONIC     /* Default clock of the absolute edge schedule */
+
+
+#define DEADLINE_TOLERANCE_NS   50000       /* Toggle interval may exceed the half period by this much before it counts as deadline miss */
+#define TRACEFS_PATH    "/sys/kernel/tracing"   /* tracefs mount point, falls back to debugfs if not mounted here */
 
 
 /**
@@ -0,0 +1,129 @@
+/**
+ * @file histogram.h
+ * @brief Producer-side aggregation of toggle intervals into histograms and outliers.
+ *
+ * At high frequencies, queueing every interval dominates the consumer. In
+ * aggregation mode (-H <us>) func_signal_gen bins every interval into a
+ * histogram of its own and queues only outliers (deviation above the
+ * threshold) and a sparse snapshot of the histogram every HIST_SNAPSHOT_NS.
+ * The tail stays exact: every interval beyond the threshold is still queued.
+ *
+ * The histogram is log-linear over the absolute deviation from the expected
+ * interval, separately for late and early intervals. Deviations below
+ * 2^HIST_SUB_BITS ns have 1 ns resolution, above that every power of two is
+ * split into HIST_HALF buckets (max. 6.25 % relative error). The bucket index
+ * takes one count-leading-zeros instruction and no branches, and the producer
+ * histogram (HIST_SLOTS * 8 bytes) stays in the L1 cache.
+ *
+ * Ring records, one uint64_t word each:
+ *   <interval>                     outlier, bit 63 clear
+ *   HIST_SNAPSHOT_TAG | <n>        snapshot header, followed by n entries
+ *   (slot << HIST_COUNT_BITS) | c  snapshot entry: c intervals in slot
+ */
+
+#pragma once
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ringbuffer.h"
+#include "stats.h"
+
+#define HIST_SUB_BITS       5                   /* 1 ns resolution below 2^HIST_SUB_BITS ns */
+#define HIST_MAX_BITS       32                  /* Deviations are clamped to 2^HIST_MAX_BITS - 1 ns (~4.3 s) */
+#define HIST_HALF           (1 << (HIST_SUB_BITS - 1))
+#define HIST_BUCKETS        ((HIST_MAX_BITS - HIST_SUB_BITS + 2) * HIST_HALF)
+#define HIST_SLOTS          (2 * HIST_BUCKETS)  /* Late buckets first, then early buckets */
+#define HIST_SNAPSHOT_NS    100000000UL         /* Signal time between two snapshots */
+#define HIST_RECORD_ENTRIES 31                  /* Max. entries per snapshot record, fits into SIM_RING_HEADROOM */
+#define HIST_SNAPSHOT_TAG   (1ULL << 63)
+#define HIST_COUNT_BITS     48
+#define HIST_FINISH_MS      1000                /* Max. wait for ring space for the final snapshot */
+#define HIST_COUNT_MASK     ((1ULL << HIST_COUNT_BITS) - 1)
+
+typedef struct {
+    uint64_t        counts[HIST_SLOTS];
+    uint64_t        total;
+} histogram_t;
+
+typedef struct {
+    uint64_t        counts[HIST_SLOTS];     /* Intervals binned since the last snapshot */
+    uint64_t        expected_ns;
+    uint64_t        threshold_ns;           /* Deviations above this are queued as outliers */
+    uint64_t        since_snapshot_ns;      /* Signal time since the last snapshot */
+    uint64_t        samples;
+    uint64_t        outliers;
+    uint64_t        dropped;                /* Outliers lost because the ring buffer was full */
+    uint64_t        snapshots;
+    uint64_t        lost;                   /* Counts of the final snapshot lost because nobody drained the ring */
+} aggregate_t;
+
+
+/**
+ * Function declarations
+ */
+
+extern void aggregate_init(aggregate_t* agg, uint64_t expected_ns, uint64_t threshold_ns);
+extern bool aggregate_snapshot(aggregate_t* agg, ring_buffer_t* rbuffer);
+extern void aggregate_finish(aggregate_t* agg, ring_buffer_t* rbuffer);
+extern void aggregate_report(const aggregate_t* agg);
+
+extern void histogram_merge_entry(histogram_t* hist, uint64_t entry);
+extern int64_t histogram_slot_value(size_t slot);
+extern int histogram_stats(const histogram_t* hist, const uint64_t* outliers, size_t num_outliers,
+                           uint64_t expected_ns, uint64_t threshold_ns, uint64_t tolerance_ns,
+                           jitter_stats_t* out);
+extern void histogram_write(const char* filename, const histogram_t* hist);
+
+
+/**
+ * @brief Bucket index of a deviation in ns, without branches.
+ */
+static inline size_t histogram_bucket(uint64_t dev) {
+    const uint64_t max = (1ULL << HIST_MAX_BITS) - 1;
+    dev = (dev < max) ? dev : max;
+
+    /* Highest set bit, at least HIST_SUB_BITS - 1: below 2^HIST_SUB_BITS the shift is 0 */
+    unsigned int shift = (63 - __builtin_clzll(dev | (HIST_HALF * 2 - 1))) - (HIST_SUB_BITS - 1);
+    return ((size_t)shift * HIST_HALF) + (size_t)(dev >> shift);
+}
+
+/**
+ * @brief Bin one interval and queue it if it is an outlier.
+ *
+ * Call this from the signal generation thread instead of WRITE_TO_RINGBUFFER().
+ * Sends a histogram snapshot every HIST_SNAPSHOT_NS of signal time; if the
+ * ring buffer is too full, the snapshot is retried with the next interval.
+ *
+ * @param agg The aggregation state.
+ * @param rbuffer The ring buffer to the data handler.
+ * @param diff_ns The measured interval.
+ */
+static inline void aggregate_sample(aggregate_t* agg, ring_buffer_t* rbuffer, uint64_t diff_ns) {
+    bool early = diff_ns < agg->expected_ns;
+    uint64_t dev = early ? agg->expected_ns - diff_ns : diff_ns - agg->expected_ns;
+
+    agg->counts[(size_t)early * HIST_BUCKETS + histogram_bucket(dev)]++;
+    agg->samples++;
+
+    if (__builtin_expect(dev > agg->threshold_ns, 0)) {
+        /* The ring buffer drops bytes when full, only queue complete words */
+        if (RING_BUFFER_MASK(rbuffer) - ring_buffer_num_items(rbuffer) >= sizeof(uint64_t)) {
+            WRITE_TO_RINGBUFFER(rbuffer, diff_ns);
+            agg->outliers++;
+        } else {
+            agg->dropped++;
+        }
+    }
+
+    agg->since_snapshot_ns += diff_ns;
+    if (__builtin_expect(agg->since_snapshot_ns >= HIST_SNAPSHOT_NS, 0) && aggregate_snapshot(agg, rbuffer)) {
+        agg->since_snapshot_ns = 0;
+    }
+}
+
+#endif
@@ -0,0 +1,56 @@
+/**
+ * @file load.h
+ * @brief Background load generator for jitter-under-stress measurements.
+ *
+ * Spawns stressor threads on all non-RT cores (or on all cores) while the
+ * signal generator runs. The active load types are tagged in the statistics
+ * printed at the end of a run, so the isolation quality (isolcpus, nohz_full)
+ * can be quantified with a single command.
+ */
+
+#pragma once
+
+#ifndef LOAD_H
+#define LOAD_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#define LOAD_MEM_SIZE       (64UL << 20)    /* Buffer per memory stressor, larger than any last-level cache */
+#define LOAD_CACHE_LINE     64              /* Stride of the cache thrash loop */
+#define LOAD_IO_BLOCK       4096            /* Size of one write() of the I/O stressor, followed by fsync() */
+#define LOAD_IO_MAX_SIZE    (16UL << 20)    /* Truncate the I/O stressor's file when it reaches this size */
+#define LOAD_IO_DIR         "."             /* Default directory for the I/O stressor's files, must be disk-backed (not tmpfs) */
+#define LOAD_IO_DIR_LEN     256             /* Max. length of the I/O stressor's directory */
+#define LOAD_TIMERS         64              /* timerfds per timer stressor */
+#define LOAD_TIMER_NS       100000          /* Base period of the timer stressor's timerfds */
+#define LOAD_MAX_THREADS    256
+
+typedef enum {
+    LOAD_NONE       = 0,
+    LOAD_MEM        = 1 << 0,               /* Memory bandwidth and cache thrash */
+    LOAD_SYSCALL    = 1 << 1,               /* Syscall / context switch storm via pipe ping-pong */
+    LOAD_IO         = 1 << 2,               /* File writes with fsync */
+    LOAD_TIMER      = 1 << 3,               /* Timer / IRQ pressure via many timerfds */
+} load_type_t;
+
+typedef struct {
+    pthread_t       threads[LOAD_MAX_THREADS];
+    size_t          num_threads;
+    const char*     io_dir;                 /* Directory of the I/O stressor's files */
+    volatile bool   stop;
+} load_t;
+
+
+/**
+ * Function declarations
+ */
+
+extern int load_parse(const char* arg, unsigned int* types, char* io_dir);
+extern void load_format(unsigned int types, char* buf, size_t len);
+extern load_t* load_start(unsigned int types, const char* io_dir, int rt_core, bool all_cores);
+extern void load_stop(load_t* load);
+
+#endif
@@ -19,9 +19,16 @@
 #include <gpiod.h>
 #include <sched.h>
 #include <sys/timerfd.h>
+#include <sys/resource.h>
 
 #include "config.h"
 #include "ringbuffer.h"
+#include "trace.h"
+#include "stats.h"
+#include "load.h"
+#include "schedule.h"
+#include "sim.h"
+#include "histogram.h"
 
 #define MAX_SIGNAL_FREQ     10000           /* MAX Target signal frequency*/
 #define SEC_IN_NS           1000000000UL    
@@ -37,16 +44,44 @@ typedef struct {
     struct gpiod_line*  line;
 } gpio_handle_t;
 
+typedef struct capture_t capture_t;
+
+typedef enum {
+    WAIT_BLOCKING,                          /* Sleep until the next edge, e.g. clock_nanosleep() */
+    WAIT_POLLING,                           /* Busy-wait until the next edge */
+} wait_mode_t;
+
 typedef struct {
     gpio_handle_t*  gpio;
     ring_buffer_t*  rbuffer;
+    capture_t*      capture;
+    schedule_t*     schedule;
+    aggregate_t*    aggregate;
     uint64_t        half_period_ns;
+    wait_mode_t     wait_mode;
+    unsigned int    duration_s;
     int             sched_prio;
     int             timer_fd;
     int             core_id;
     bool            killswitch;
+    bool            genDone;
     bool            doPlot;
+    bool            traceMarker;
+    uint64_t        break_ns;
+    unsigned int    load_types;
+    bool            loadAllCores;
+    char            loadIoDir[LOAD_IO_DIR_LEN];
     const char*     outputFile;
+    const char*     captureDevice;
+    const char*     captureFile;
+    const char*     phaseFile;
+    const char*     simModel;
+    clockid_t       clock;
+    clockid_t       ref_clock;
+    bool            discipline;
+    uint64_t        aggregate_ns;
+    const char*     histFile;
+    struct rusage   genUsage;               /* Usage of the signal generation thread, without stressors */
 } thread_args_t;
 
 typedef struct {
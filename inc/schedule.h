@@ -0,0 +1,79 @@
+/**
+ * @file schedule.h
+ * @brief Absolute edge schedule with long-run drift tracking.
+ *
+ * The interval between two toggles does not show drift: interval errors can
+ * cancel out or accumulate. The schedule therefore keeps an absolute ideal
+ * edge time, anchored at start on a selectable clock, and records the phase
+ * error of every edge against it. The drift rate is the least-squares slope
+ * of the phase error over time.
+ *
+ * Optionally, the schedule is disciplined against a reference clock (e.g.
+ * CLOCK_TAI / CLOCK_REALTIME steered by PTP or NTP) with a PI servo, so long
+ * soak runs stay phase-accurate to the reference.
+ */
+
+#pragma once
+
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "ringbuffer.h"
+
+#define SCHEDULE_RING_SIZE      4096        /* Number of phase errors (int64_t) in the ring buffer */
+#define SCHEDULE_SERVO_NS       1000000000L /* Interval between two servo updates */
+#define SCHEDULE_SERVO_KP       0.7         /* Proportional constant of the servo */
+#define SCHEDULE_SERVO_KI       0.3         /* Integral constant of the servo */
+
+/* Helper Macro */
+#define WRITE_PHASE_TO_RINGBUFFER(rbuffer, phase) \
+        (ring_buffer_queue_arr(rbuffer, (char*)&phase, sizeof(int64_t)))
+
+typedef struct {
+    clockid_t       clock;                  /* Clock of the schedule */
+    uint64_t        half_period_ns;
+    int64_t         anchor_ns;              /* Time of edge 0 on the schedule clock */
+    uint64_t        edge;                   /* Number of the next edge */
+
+    /* Discipline against a reference clock */
+    bool            discipline;
+    clockid_t       ref_clock;
+    int64_t         ref_offset0_ns;         /* Offset reference - schedule clock at anchor */
+    int64_t         servo_last_ns;          /* Time of the last servo update since anchor */
+    double          servo_corr_ns;          /* Phase correction at the last servo update */
+    double          servo_rate;             /* Frequency correction in ns per ns */
+
+    /* Phase error statistics, updated per edge */
+    int64_t         phase_err_ns;           /* Phase error of the last edge */
+    int64_t         phase_max_ns;
+    int64_t         phase_min_ns;
+    uint64_t        count;
+    double          mean_t;                 /* Running means and co-moments for the drift regression */
+    double          mean_err;
+    double          m2_t;
+    double          c_t_err;
+
+    ring_buffer_t   rbuffer;                /* Phase error per edge for the data handler */
+    uint64_t        dropped;                /* Phase errors lost because the ring buffer was full */
+    char            ring_buf[SCHEDULE_RING_SIZE * sizeof(int64_t)];
+} schedule_t;
+
+
+/**
+ * Function declarations
+ */
+
+extern int schedule_parse_clock(const char* name, clockid_t* clock);
+extern const char* schedule_clock_name(clockid_t clock);
+extern void schedule_init(schedule_t* s, clockid_t clock, uint64_t half_period_ns,
+                          bool discipline, clockid_t ref_clock);
+extern void schedule_start(schedule_t* s);
+extern void schedule_next(schedule_t* s, struct timespec* deadline);
+extern int64_t schedule_record(schedule_t* s, const struct timespec* actual);
+extern void schedule_report(schedule_t* s);
+
+#endif
@@ -0,0 +1,97 @@
+/**
+ * @file sim.h
+ * @brief Virtual-time simulation of the signal generator's clock, sleep and GPIO calls.
+ *
+ * The sim_* wrappers below replace clock_gettime(), clock_nanosleep() and
+ * gpiod_line_set_value() in the generator loop. Normally they forward to the
+ * real calls. The loop in main.c is a template: whoever implements it has to
+ * use the wrappers, otherwise virtual time does not advance and main() gives up
+ * after SIM_STALL_MS. In simulation mode (-S <model>) time is virtual: a sleep returns
+ * immediately, advancing virtual time to the deadline plus a wakeup latency
+ * drawn from the configured model, and GPIO writes are discarded. The real
+ * generator loop and the whole consumer pipeline (ring buffer, statistics,
+ * writer) then run as fast as the CPU allows, deterministically.
+ *
+ * Latency models, combined with ',':
+ *   const:<ns>             fixed latency
+ *   uniform:<min>:<max>    uniformly distributed latency
+ *   normal:<mean>:<sd>     normally distributed latency, clamped at 0
+ *   exp:<mean>             exponentially distributed latency
+ *   spike:<prob>:<ns>      additional latency with the given probability
+ *   replay:<file>          latencies replayed from per-edge phase errors written
+ *                          with -P (lateness against the ideal schedule)
+ */
+
+#pragma once
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <time.h>
+#include <gpiod.h>
+
+#include "ringbuffer.h"
+
+#define SIM_EPOCH_NS        1000000000LL    /* Virtual time at start */
+#define SIM_CLOCK_COST_NS   20              /* Virtual time consumed by one clock read, lets polling loops progress */
+#define SIM_GPIO_COST_NS    1000            /* Virtual time consumed by one GPIO write */
+#define SIM_RING_HEADROOM   256             /* Free bytes kept in each registered ring buffer (backpressure) */
+#define SIM_MAX_RINGS       4
+#define SIM_REFRESH_US      1000            /* Data handler refresh interval in simulation mode */
+#define SIM_STALL_MS        2000            /* Give up if virtual time does not advance for this long in real time */
+#define SIM_SEED            0x5EED5EED5EEDULL
+
+/* True if simulation mode is active */
+extern bool sim_active;
+
+
+/**
+ * Function declarations
+ */
+
+extern int sim_init(const char* model);
+extern void sim_register_ring(ring_buffer_t* rbuffer);
+extern void sim_set_duration(int64_t duration_ns);
+extern void sim_stop(void);
+extern int64_t sim_elapsed_ns(void);
+extern void sim_report(void);
+extern void sim_free(void);
+
+extern int sim_virtual_gettime(struct timespec* ts);
+extern int sim_virtual_sleep(int flags, const struct timespec* req);
+extern int sim_virtual_gpio(int value);
+
+
+/**
+ * @brief clock_gettime(), or the virtual time in simulation mode.
+ */
+static inline int sim_clock_gettime(clockid_t clock, struct timespec* ts) {
+    if (__builtin_expect(!sim_active, 1)) {
+        return clock_gettime(clock, ts);
+    }
+    return sim_virtual_gettime(ts);
+}
+
+/**
+ * @brief clock_nanosleep(), or a virtual sleep with injected wakeup latency in simulation mode.
+ */
+static inline int sim_clock_nanosleep(clockid_t clock, int flags, const struct timespec* req, struct timespec* rem) {
+    if (__builtin_expect(!sim_active, 1)) {
+        return clock_nanosleep(clock, flags, req, rem);
+    }
+    return sim_virtual_sleep(flags, req);
+}
+
+/**
+ * @brief gpiod_line_set_value(), or a no-op costing SIM_GPIO_COST_NS of virtual time in simulation mode.
+ */
+static inline int sim_gpio_set_value(struct gpiod_line* line, int value) {
+    if (__builtin_expect(!sim_active, 1)) {
+        return gpiod_line_set_value(line, value);
+    }
+    return sim_virtual_gpio(value);
+}
+
+#endif
@@ -0,0 +1,68 @@
+/**
+ * @file stats.h
+ * @brief Statistics over recorded toggle intervals.
+ *
+ * Shared between RPISignal and the benchmark tools. Does not depend on libgpiod.
+ */
+
+#pragma once
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/* Summary line of RPISignal with the CPU usage of the signal generation thread alone, parsed by the sweep */
+#define GEN_USAGE_FORMAT    "Generator thread: utime %.1f ms, stime %.1f ms, nvcsw %ld, nivcsw %ld\n"
+#define GEN_USAGE_SCAN      "Generator thread: utime %lf ms, stime %lf ms, nvcsw %ld, nivcsw %ld"
+
+/**
+ * Summary of the jitter (measured interval minus expected interval) of a run.
+ */
+typedef struct {
+    size_t      count;
+    int64_t     min;
+    int64_t     p50;
+    int64_t     p90;
+    int64_t     p99;
+    int64_t     p999;
+    int64_t     max;
+    int64_t     max_abs;                    /* Largest deviation in either direction */
+    double      mean;
+    double      stddev;
+    size_t      overruns;                   /* Intervals longer than expected + tolerance */
+} jitter_stats_t;
+
+/**
+ * Result of a two-sample Kolmogorov-Smirnov test.
+ */
+typedef struct {
+    double      d;                          /* Largest distance between the empirical CDFs */
+    double      p_value;                    /* Asymptotic p-value for equal distributions */
+} ks_result_t;
+
+/**
+ * Bootstrap confidence interval of the difference of a percentile (b - a).
+ */
+typedef struct {
+    double      delta;                      /* Percentile difference of the full samples */
+    double      ci_low;                     /* Lower bound of the confidence interval */
+    double      ci_high;                    /* Upper bound of the confidence interval */
+} bootstrap_result_t;
+
+
+/**
+ * Function declarations
+ */
+
+extern int stats_load_csv(const char* filename, uint64_t** diffs, size_t* count);
+extern int64_t stats_percentile(const int64_t* sorted, size_t count, double pct);
+extern int stats_compute(const uint64_t* diffs, size_t count, uint64_t expected_ns,
+                         uint64_t tolerance_ns, jitter_stats_t* out);
+extern int stats_ks_test(const uint64_t* a, size_t na, const uint64_t* b, size_t nb, ks_result_t* out);
+extern int stats_bootstrap_delta(const uint64_t* a, size_t na, const uint64_t* b, size_t nb, double pct,
+                                 unsigned int iterations, double confidence, uint64_t seed,
+                                 bootstrap_result_t* out);
+
+#endif
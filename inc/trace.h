@@ -0,0 +1,105 @@
+/**
+ * @file trace.h
+ * @brief Hot-path tracepoints for the signal generator.
+ *
+ * Every tracepoint is emitted as a USDT probe (provider "rpisignal") when
+ * <sys/sdt.h> is available at build time, and additionally as a line in the
+ * ftrace 'trace_marker' file when enabled with '-t'. With '-b <us>' tracing
+ * is stopped (tracing_on = 0) on the first deadline miss above the threshold,
+ * so the kernel trace buffer ends with the lead-up to the outlier.
+ *
+ * Probes can be listed with e.g. 'perf list sdt' or 'bpftrace -l usdt:./RPISignal'.
+ */
+
+#pragma once
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "config.h"
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define TRACE_PROBE1(name, a)       DTRACE_PROBE1(rpisignal, name, a)
+#define TRACE_PROBE2(name, a, b)    DTRACE_PROBE2(rpisignal, name, a, b)
+#else
+#define TRACE_PROBE1(name, a)       do { (void)(a); } while (0)
+#define TRACE_PROBE2(name, a, b)    do { (void)(a); (void)(b); } while (0)
+#endif
+
+/* File descriptor of tracefs 'trace_marker', -1 if disabled */
+extern int trace_marker_fd;
+
+/* Latency threshold in ns above which tracing is stopped, 0 if disabled */
+extern uint64_t trace_break_ns;
+
+
+/**
+ * Function declarations
+ */
+
+extern int trace_init(bool use_marker, uint64_t break_ns);
+extern void trace_close(void);
+extern void trace_marker_printf(const char* fmt, ...);
+extern void trace_breaktrace(uint64_t latency_ns);
+
+
+/**
+ * @brief Tracepoint: the signal generation thread woke up for the next edge.
+ *
+ * @param sample Number of the upcoming edge.
+ */
+static inline void trace_wake(uint64_t sample) {
+    TRACE_PROBE1(wake, sample);
+    if (trace_marker_fd >= 0) {
+        trace_marker_printf("rpisignal: wake sample=%" PRIu64 "\n", sample);
+    }
+}
+
+/**
+ * @brief Tracepoint: the GPIO line has been set to a new level.
+ *
+ * @param sample Number of the edge.
+ * @param value The new line level (0 or 1).
+ */
+static inline void trace_edge(uint64_t sample, int value) {
+    TRACE_PROBE2(edge, sample, value);
+    if (trace_marker_fd >= 0) {
+        trace_marker_printf("rpisignal: edge sample=%" PRIu64 " value=%d\n", sample, value);
+    }
+}
+
+/**
+ * @brief Tracepoint: check a measured toggle interval for a deadline miss.
+ *
+ * An interval longer than the expected one by more than DEADLINE_TOLERANCE_NS
+ * is reported as a deadline miss. If breaktrace is enabled and the lateness
+ * exceeds its threshold, kernel tracing is stopped, independent of the
+ * tolerance.
+ *
+ * @param sample Number of the edge.
+ * @param diff_ns Measured time between the last two toggles.
+ * @param expected_ns Expected time between two toggles.
+ */
+static inline void trace_deadline(uint64_t sample, uint64_t diff_ns, uint64_t expected_ns) {
+    if (diff_ns <= expected_ns) {
+        return;
+    }
+
+    uint64_t late_ns = diff_ns - expected_ns;
+    if (late_ns > DEADLINE_TOLERANCE_NS) {
+        TRACE_PROBE2(deadline_miss, sample, late_ns);
+        if (trace_marker_fd >= 0) {
+            trace_marker_printf("rpisignal: deadline_miss sample=%" PRIu64 " late=%" PRIu64 "ns\n", sample, late_ns);
+        }
+    }
+
+    if (trace_break_ns != 0 && late_ns > trace_break_ns) {
+        trace_breaktrace(late_ns);
+    }
+}
+
+#endif
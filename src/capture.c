@@ -0,0 +1,323 @@
+/**
+ * @file capture.c
+ *
+ * This file contains the edge input-capture / loopback mode: requesting the
+ * capture line, reading kernel-timestamped edge events in batches and
+ * correlating them with the edges set by the signal generator.
+ *
+ */
+
+#include "../inc/main.h"
+#include "../inc/capture.h"
+
+#include <string.h>
+
+
+#define INITIAL_CAPACITY 1024
+#define CAPACITY_MULTIPLIER 2
+
+
+/**
+ * @brief Append an edge to a dynamically growing array.
+ *
+ * @return int 0 on success, or -1 on failure.
+ */
+static int append_edge(capture_edge_t** edges, size_t* count, size_t* capacity, capture_edge_t edge) {
+    if (*count >= *capacity) {
+        size_t new_capacity = (*capacity == 0) ? INITIAL_CAPACITY : (*capacity * CAPACITY_MULTIPLIER);
+        capture_edge_t* temp = realloc(*edges, new_capacity * sizeof(capture_edge_t));
+        if (!temp) {
+            perror("realloc failed");
+            return -1;
+        }
+        *edges = temp;
+        *capacity = new_capacity;
+    }
+    (*edges)[(*count)++] = edge;
+    return 0;
+}
+
+
+/**
+ * @brief Drain all software edges queued by the signal generator.
+ *
+ * @return int 0 on success, or -1 on failure.
+ */
+static int dequeue_sw_edges(capture_t* cap) {
+    capture_edge_t edge;
+    /* Only complete edges, the generator may still be writing the last one */
+    while (ring_buffer_num_items(&cap->sw_ring) >= sizeof(capture_edge_t)) {
+        ring_buffer_dequeue_arr(&cap->sw_ring, (char*)&edge, sizeof(capture_edge_t));
+        if (append_edge(&cap->sw_edges, &cap->sw_count, &cap->sw_capacity, edge) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Request a GPIO line for both edge events.
+ *
+ * @param device GPIO chip and pin in the format gpiochipX:XX.
+ * @param half_period_ns Intended time between two edges.
+ * @return capture_t* The capture context, or NULL on failure.
+ */
+capture_t* capture_init(const char* device, uint64_t half_period_ns) {
+    if (strlen(device) >= 13 || strlen(device) < 11 || device[9] != ':') {
+        fprintf(stderr, "Invalid capture GPIO. Expected Format: gpiochipX:XX\n");
+        return NULL;
+    }
+
+    char gpio_chip[16] = "/dev/";
+    strncpy(gpio_chip + 5, device, 9);
+    gpio_chip[14] = '\0';
+
+    int gpio_pin = atoi(device + 10);
+    if (gpio_pin < 0 || gpio_pin > 31) {
+        fprintf(stderr, "Invalid capture GPIO Pin. Expected: gpiochipX:XX\n");
+        return NULL;
+    }
+
+    capture_t* cap = calloc(1, sizeof(capture_t));
+    if (!cap) {
+        perror("Fehler bei calloc");
+        return NULL;
+    }
+
+    cap->gpio = malloc(sizeof(gpio_handle_t));
+    cap->sw_ring_buf = malloc(CAPTURE_RING_BYTES);
+    if (!cap->gpio || !cap->sw_ring_buf) {
+        perror("Fehler bei malloc");
+        free(cap->gpio);
+        free(cap->sw_ring_buf);
+        free(cap);
+        return NULL;
+    }
+
+    ring_buffer_init(&cap->sw_ring, cap->sw_ring_buf, CAPTURE_RING_BYTES);
+    cap->half_period_ns = half_period_ns;
+
+    cap->gpio->chip = gpiod_chip_open(gpio_chip);
+    if (!cap->gpio->chip) {
+        perror("Fehler beim Öffnen des Capture-GPIO-Chips");
+        goto err_free;
+    }
+    cap->gpio->line = gpiod_chip_get_line(cap->gpio->chip, gpio_pin);
+    if (!cap->gpio->line) {
+        perror("Fehler beim Abrufen der Capture-GPIO-Leitung");
+        goto err_close;
+    }
+    if (gpiod_line_request_both_edges_events(cap->gpio->line, "RPiSignal-capture") < 0) {
+        perror("Fehler bei der Konfiguration der Capture-GPIO-Leitung als Eingang");
+        goto err_close;
+    }
+
+    printf("Capturing edges on GPIO Chip: %s, Pin: %d\n", gpio_chip, gpio_pin);
+    return cap;
+
+err_close:
+    gpiod_chip_close(cap->gpio->chip);
+err_free:
+    free(cap->gpio);
+    free(cap->sw_ring_buf);
+    free(cap);
+    return NULL;
+}
+
+
+/**
+ * @brief Release the capture line and all recorded edges.
+ */
+void capture_free(capture_t* cap) {
+    if (cap == NULL) {
+        return;
+    }
+    gpiod_chip_close(cap->gpio->chip);
+    free(cap->gpio);
+    free(cap->sw_ring_buf);
+    free(cap->kernel_edges);
+    free(cap->sw_edges);
+    free(cap);
+}
+
+
+/**
+ * @brief Worker thread reading kernel-timestamped edge events of the capture line.
+ *
+ * Events are read in batches of up to CAPTURE_BATCH_SIZE. Software edges queued by
+ * the signal generator are drained in the same loop to keep the ring buffer small.
+ *
+ * @param args Pointer to the thread arguments (thread_args_t).
+ * @return void* Always returns NULL.
+ */
+void* func_capture(void* args) {
+    thread_args_t* param = (thread_args_t*)args;
+    capture_t* cap = param->capture;
+
+    /* Stick capture thread to the same core as the data handler */
+    int core = (param->core_id + 1) % sysconf(_SC_NPROCESSORS_ONLN);
+    stick_thread_to_core(core);
+
+    struct gpiod_line_event events[CAPTURE_BATCH_SIZE];
+    const struct timespec timeout = {
+        .tv_sec = 0,
+        .tv_nsec = CAPTURE_WAIT_MS * 1000000L,
+    };
+
+    while (!param->killswitch) {
+        int ret = gpiod_line_event_wait(cap->gpio->line, &timeout);
+        if (ret < 0) {
+            perror("Fehler beim Warten auf GPIO-Events");
+            break;
+        }
+
+        if (ret > 0) {
+            int num = gpiod_line_event_read_multiple(cap->gpio->line, events, CAPTURE_BATCH_SIZE);
+            if (num < 0) {
+                perror("Fehler beim Lesen der GPIO-Events");
+                break;
+            }
+            for (int i = 0; i < num; i++) {
+                capture_edge_t edge = {
+                    .ts_ns = (int64_t)events[i].ts.tv_sec * (int64_t)SEC_IN_NS + events[i].ts.tv_nsec,
+                    .value = (events[i].event_type == GPIOD_LINE_EVENT_RISING_EDGE) ? 1 : 0,
+                };
+                if (append_edge(&cap->kernel_edges, &cap->kernel_count, &cap->kernel_capacity, edge) != 0) {
+                    pthread_exit(NULL);
+                }
+            }
+        }
+
+        if (dequeue_sw_edges(cap) != 0) {
+            break;
+        }
+    }
+
+    /* Pick up edges queued after the last wakeup */
+    dequeue_sw_edges(cap);
+
+    pthread_exit(NULL);
+}
+
+
+/**
+ * @brief Correlate kernel and software edges, print a summary and optionally write a CSV file.
+ *
+ * Each kernel edge is paired with the latest software edge of the same level that
+ * was set before it, at most half a period earlier. The phase error is measured
+ * against the intended time of that software edge; edge numbers count half periods
+ * from the first intended edge. The interval jitter only uses pairs of adjacent
+ * edge numbers, gaps are reported as missing edges.
+ *
+ * @param cap The capture context.
+ * @param filename CSV file to write per-edge results to, may be NULL.
+ * @return int 0 on success, or -1 on failure.
+ */
+int capture_report(capture_t* cap, const char* filename) {
+    if (cap->kernel_count == 0) {
+        printf("Capture: no edges observed on capture line\n");
+        return 0;
+    }
+
+    capture_sample_t* samples = malloc(cap->kernel_count * sizeof(capture_sample_t));
+    if (!samples) {
+        perror("Fehler bei malloc");
+        return -1;
+    }
+
+    const int64_t half = (int64_t)cap->half_period_ns;
+    const int64_t t0 = (cap->sw_count > 0) ? cap->sw_edges[0].ideal_ns : cap->kernel_edges[0].ts_ns;
+
+    int64_t phase_min = INT64_MAX, phase_max = INT64_MIN;
+    int64_t interval_jitter_max = 0, interval_jitter_sum = 0;
+    int64_t lat_min = INT64_MAX, lat_max = INT64_MIN, lat_sum = 0;
+    size_t matched = 0, intervals = 0;
+    uint64_t missing = 0;
+    size_t j = 0;
+
+    for (size_t i = 0; i < cap->kernel_count; i++) {
+        const capture_edge_t* k = &cap->kernel_edges[i];
+        capture_sample_t* s = &samples[i];
+
+        /* Edge number from the ideal schedule, robust against lost events */
+        int64_t since = k->ts_ns - t0 + half / 2;
+        s->edge = (since > 0) ? (uint64_t)(since / half) : 0;
+        s->kernel_ts_ns = k->ts_ns;
+
+        /* Only adjacent edges, a lost event would show up as half a period of jitter */
+        if (i > 0 && s->edge > samples[i - 1].edge) {
+            uint64_t gap = s->edge - samples[i - 1].edge;
+            if (gap == 1) {
+                int64_t jitter = llabs((k->ts_ns - cap->kernel_edges[i - 1].ts_ns) - half);
+                if (jitter > interval_jitter_max) interval_jitter_max = jitter;
+                interval_jitter_sum += jitter;
+                intervals++;
+            } else {
+                missing += gap - 1;
+            }
+        }
+
+        /* Latest software edge set before the kernel observed this edge */
+        while (j + 1 < cap->sw_count && cap->sw_edges[j + 1].ts_ns <= k->ts_ns) {
+            j++;
+        }
+
+        s->latency_ns = INT64_MIN;
+        s->phase_err_ns = INT64_MIN;
+        if (j < cap->sw_count) {
+            const capture_edge_t* sw = &cap->sw_edges[j];
+            int64_t latency = k->ts_ns - sw->ts_ns;
+            if (sw->value == k->value && latency >= 0 && latency < half) {
+                s->latency_ns = latency;
+                s->phase_err_ns = k->ts_ns - sw->ideal_ns;
+                if (s->phase_err_ns < phase_min) phase_min = s->phase_err_ns;
+                if (s->phase_err_ns > phase_max) phase_max = s->phase_err_ns;
+                if (latency < lat_min) lat_min = latency;
+                if (latency > lat_max) lat_max = latency;
+                lat_sum += latency;
+                matched++;
+            }
+        }
+    }
+
+    printf("Capture: %zu edges observed, %zu software edges, %zu matched\n",
+        cap->kernel_count, cap->sw_count, matched);
+    if (missing > 0) {
+        printf("  Missing edges:         %" PRIu64 " (no kernel event, lost or never set)\n", missing);
+    }
+    if (intervals > 0) {
+        printf("  Edge interval jitter:  max %" PRId64 " ns, avg %" PRId64 " ns (%zu adjacent pairs)\n",
+            interval_jitter_max, interval_jitter_sum / (int64_t)intervals, intervals);
+    }
+    if (matched > 0) {
+        printf("  Phase error:           min %" PRId64 " ns, max %" PRId64 " ns\n", phase_min, phase_max);
+        printf("  Software-to-pin:       min %" PRId64 " ns, avg %" PRId64 " ns, max %" PRId64 " ns\n",
+            lat_min, lat_sum / (int64_t)matched, lat_max);
+    }
+
+    if (filename != NULL) {
+        FILE* fp = fopen(filename, "w");
+        if (fp == NULL) {
+            perror("Could not open capture file");
+            free(samples);
+            return -1;
+        }
+        fprintf(fp, "edge,kernel_ts_ns,phase_err_ns,latency_ns\n");
+        for (size_t i = 0; i < cap->kernel_count; i++) {
+            fprintf(fp, "%" PRIu64 ",%" PRId64 ",", samples[i].edge, samples[i].kernel_ts_ns);
+            if (samples[i].phase_err_ns != INT64_MIN) {
+                fprintf(fp, "%" PRId64, samples[i].phase_err_ns);
+            }
+            fprintf(fp, ",");
+            if (samples[i].latency_ns != INT64_MIN) {
+                fprintf(fp, "%" PRId64, samples[i].latency_ns);
+            }
+            fprintf(fp, "\n");
+        }
+        fclose(fp);
+    }
+
+    free(samples);
+    return 0;
+}
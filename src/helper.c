@@ -1,8 +1,8 @@
 /**
  * @file helper.c
  * 
- * This file contains helper functions for GPIO initialization, Program configuration,
- * thread management, and data handling. Change at your own risk.
+ * This file contains helper functions for Program configuration and data handling.
+ * GPIO initialization and thread management live in platform.c. Change at your own risk.
  * 
  */
 
@@ -22,99 +22,56 @@
 FILE* setup_gnuplot();
 void plot_to_gnuplot(measurement_t* m, size_t num, FILE* gp, uint64_t period_ns);
 void print_help(const char* progname);
+void print_summary(measurement_t* m, size_t num, const histogram_t* hist, thread_args_t* param);
+int dequeue_phase_errors(ring_buffer_t* rbuffer, int64_t** all_phases, size_t* all_count, size_t* capacity);
+void write_phase_to_file(const char* filename, int64_t* phases, size_t num);
 
 
 /**
- * @brief Initialize the GPIO port and return a handle.
- *
- * @param gpio_pin The GPIO pin number.
- * @param gpio_chip The GPIO chip name.
- * @return gpio_handle_t* Pointer to the GPIO handle, or NULL on failure.
- */
-gpio_handle_t* init_gpio(int gpio_pin, const char* gpio_chip) {
-    gpio_handle_t* handle = malloc(sizeof(gpio_handle_t));
-    if (!handle) {
-        perror("Fehler bei malloc");
-        return NULL;
-    }
-
-    if (gpio_chip == NULL) {
-        perror("Fehler, kein GPIO Chip gegeben. Nutze gpioinfo, um herauszufinden welchen chip du benötigst");
-        free(handle);
-        return NULL;
-    }
-    handle->chip = gpiod_chip_open(gpio_chip);
-    if (!handle->chip) {
-        perror("Fehler beim Öffnen des GPIO-Chips");
-        free(handle);
-        return NULL;
-    }
-    handle->line = gpiod_chip_get_line(handle->chip, gpio_pin);
-    if (!handle->line) {
-        perror("Fehler beim Abrufen der GPIO-Leitung");
-        gpiod_chip_close(handle->chip);
-        free(handle);
-        return NULL;
-    }
-    if (gpiod_line_request_output(handle->line, "RPiSignal", 0) < 0) {
-        perror("Fehler bei der Konfiguration der GPIO-Leitung als Ausgang");
-        gpiod_chip_close(handle->chip);
-        free(handle);
-        return NULL;
-    }
-    return handle;
-}
-
-
-/**
- * @brief Bind the thread to a specific CPU core.
- *
- * @param core_id The CPU core ID.
- * @return int 0 on success, or an error code on failure.
+ * @brief Read the word at a byte offset of the ring buffer without removing it.
  */
-int stick_thread_to_core(int core_id) {
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    CPU_SET(core_id, &cpuset);
-
-    int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
-    if(ret != 0) {
-        perror("Fehler beim Setzen der CPU-Affinität\n");
+static void peek_word(ring_buffer_t* rbuffer, size_t offset, uint64_t* word) {
+    for (size_t i = 0; i < sizeof(uint64_t); i++) {
+        ring_buffer_peek(rbuffer, (char*)word + i, offset + i);
     }
-    return ret;
-}
-
-
-/**
- * @brief Set thread priority (if needed).
- *
- * @param priority The thread priority.
- * @return int 0 on success, or an error code on failure.
- */
-int set_thread_priority(int priority) {
-    struct sched_param schedParam;
-    schedParam.sched_priority = priority;
-    int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &schedParam);
-    if(ret != 0) {
-        perror("Fehler beim Setzen des Echtzeit-Schedulings");
-    }
-    return ret;
 }
 
 
 /**
  * @brief Dequeue measurements from the ring buffer and store them in a dynamically allocated array.
  *
+ * Only complete words and, in aggregation mode, complete snapshot records are
+ * dequeued; the rest is picked up by the next call.
+ *
  * @param rbuffer The ring buffer.
+ * @param hist Merged histogram in aggregation mode, or NULL.
  * @param all_measurements Pointer to the array of measurements.
  * @param all_count Pointer to the count of measurements.
  * @param capacity Pointer to the capacity of the array.
  * @return int 0 on success, or -1 on failure.
  */
-int dequeue_measurements(ring_buffer_t* rbuffer, measurement_t** all_measurements, size_t* all_count, size_t* capacity) {
+int dequeue_measurements(ring_buffer_t* rbuffer, histogram_t* hist, measurement_t** all_measurements, size_t* all_count, size_t* capacity) {
     measurement_t m;
     uint64_t diff;
-    while (ring_buffer_dequeue_arr(rbuffer, (char*)&diff, sizeof(uint64_t)) == sizeof(uint64_t)) {
+    while (ring_buffer_num_items(rbuffer) >= sizeof(uint64_t)) {
+        peek_word(rbuffer, 0, &diff);
+
+        /* Histogram snapshot record of the aggregation mode */
+        if (hist != NULL && (diff & HIST_SNAPSHOT_TAG)) {
+            size_t entries = (size_t)(diff & HIST_COUNT_MASK);
+            if (ring_buffer_num_items(rbuffer) < (entries + 1) * sizeof(uint64_t)) {
+                break;
+            }
+            ring_buffer_dequeue_arr(rbuffer, (char*)&diff, sizeof(uint64_t));
+            for (size_t i = 0; i < entries; i++) {
+                uint64_t entry;
+                ring_buffer_dequeue_arr(rbuffer, (char*)&entry, sizeof(uint64_t));
+                histogram_merge_entry(hist, entry);
+            }
+            continue;
+        }
+
+        ring_buffer_dequeue_arr(rbuffer, (char*)&diff, sizeof(uint64_t));
         if (*all_count >= *capacity) {
             size_t new_capacity = (*capacity == 0) ? INITIAL_CAPACITY : (*capacity * CAPACITY_MULTIPLIER);
             measurement_t* temp = realloc(*all_measurements, new_capacity * sizeof(measurement_t));
@@ -133,6 +90,61 @@ int dequeue_measurements(ring_buffer_t* rbuffer, measurement_t** all_measurement
 }
 
 
+/**
+ * @brief Dequeue per-edge phase errors of the schedule and store them in a dynamically allocated array.
+ *
+ * @param rbuffer The ring buffer of the schedule.
+ * @param all_phases Pointer to the array of phase errors.
+ * @param all_count Pointer to the count of phase errors.
+ * @param capacity Pointer to the capacity of the array.
+ * @return int 0 on success, or -1 on failure.
+ */
+int dequeue_phase_errors(ring_buffer_t* rbuffer, int64_t** all_phases, size_t* all_count, size_t* capacity) {
+    int64_t phase;
+    /* Only complete words, the generator may still be writing the last one */
+    while (ring_buffer_num_items(rbuffer) >= sizeof(int64_t)) {
+        ring_buffer_dequeue_arr(rbuffer, (char*)&phase, sizeof(int64_t));
+        if (*all_count >= *capacity) {
+            size_t new_capacity = (*capacity == 0) ? INITIAL_CAPACITY : (*capacity * CAPACITY_MULTIPLIER);
+            int64_t* temp = realloc(*all_phases, new_capacity * sizeof(int64_t));
+            if (!temp) {
+                perror("realloc failed");
+                return -1;
+            }
+            *all_phases = temp;
+            *capacity = new_capacity;
+        }
+        (*all_phases)[(*all_count)++] = phase;
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Write per-edge phase errors to a CSV file.
+ *
+ * @param filename The name of the CSV file.
+ * @param phases The array of phase errors.
+ * @param num The number of phase errors.
+ */
+void write_phase_to_file(const char* filename, int64_t* phases, size_t num) {
+    if (phases == NULL) {
+        return;
+    }
+
+    FILE* fp = fopen(filename, "w");
+    if (fp == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < num; ++i) {
+        fprintf(fp, "%" PRId64 "\n", phases[i]);
+    }
+
+    fclose(fp);
+}
+
+
 /**
  * @brief Write measurements to a CSV file.
  *
@@ -187,27 +199,77 @@ void* func_data_handler(void* args) {
     measurement_t* all_measurements = NULL;
     size_t all_count = 0, capacity = 0;
 
+    int64_t* all_phases = NULL;
+    size_t phase_count = 0, phase_capacity = 0;
+
+    /* Merged histogram snapshots - only in aggregation mode */
+    histogram_t* hist = NULL;
+    if (param->aggregate != NULL) {
+        hist = calloc(1, sizeof(histogram_t));
+        if (!hist) {
+            perror("calloc failed");
+            pthread_exit(NULL);
+        }
+    }
+
     while (!param->killswitch) {
-        if (dequeue_measurements(param->rbuffer, &all_measurements, &all_count, &capacity) != 0) {
+        if (dequeue_measurements(param->rbuffer, hist, &all_measurements, &all_count, &capacity) != 0) {
+            break;
+        }
+
+        if (dequeue_phase_errors(&param->schedule->rbuffer, &all_phases, &phase_count, &phase_capacity) != 0) {
             break;
         }
 
         if (param->doPlot) {
-            plot_to_gnuplot(all_measurements, all_count, gp, param->period_ns);
+            plot_to_gnuplot(all_measurements, all_count, gp, param->half_period_ns);
         }
 
-        usleep(WINDOW_REFRESH * 1000);  // WINDOW_REFRESH in ms (e.g. 500 ms)
+        /* Drain quickly in simulation mode, the generator waits for free ring space */
+        usleep(sim_active ? SIM_REFRESH_US : WINDOW_REFRESH * 1000);  // WINDOW_REFRESH in ms (e.g. 500 ms)
     }
         
+    /* Keep draining until the generator has queued its last edge, so no sample depends on timing */
+    while (!__atomic_load_n(&param->genDone, __ATOMIC_ACQUIRE)) {
+        dequeue_measurements(param->rbuffer, hist, &all_measurements, &all_count, &capacity);
+        dequeue_phase_errors(&param->schedule->rbuffer, &all_phases, &phase_count, &phase_capacity);
+        usleep(sim_active ? SIM_REFRESH_US : 1000);
+    }
+
+    /* Pick up everything queued after the last refresh */
+    dequeue_measurements(param->rbuffer, hist, &all_measurements, &all_count, &capacity);
+
+    /* Phase errors of the last refresh interval (up to WINDOW_REFRESH ms), otherwise missing in the -P export */
+    dequeue_phase_errors(&param->schedule->rbuffer, &all_phases, &phase_count, &phase_capacity);
+
+    /* Print jitter statistics, tagged with the active background load */
+    print_summary(all_measurements, all_count, hist, param);
+
     /* Write all recorded timestamps to csv file for post processing */
-    if (*(param->outputFile) != -1) {
+    if (param->outputFile != NULL) {
         write_to_file(param->outputFile, all_measurements, all_count);
     }
 
+    /* Write per-edge phase errors of the absolute schedule */
+    if (param->phaseFile != NULL) {
+        write_phase_to_file(param->phaseFile, all_phases, phase_count);
+    }
+
+    /* Write the merged jitter histogram of the aggregation mode */
+    if (param->histFile != NULL) {
+        histogram_write(param->histFile, hist);
+    }
+
     if (all_measurements != NULL) {
         free(all_measurements);
     }
 
+    if (all_phases != NULL) {
+        free(all_phases);
+    }
+
+    free(hist);
+
     if (gp) {
         fclose(gp);
     }
@@ -216,6 +278,61 @@ void* func_data_handler(void* args) {
 }
 
 
+/**
+ * @brief Print jitter statistics of all measurements, tagged with the active background load.
+ *
+ * In aggregation mode the statistics come from the merged histogram, with the
+ * measurements being the outliers.
+ *
+ * @param m The array of measurements.
+ * @param num The number of measurements.
+ * @param hist The merged histogram in aggregation mode, or NULL.
+ * @param param The thread arguments.
+ */
+void print_summary(measurement_t* m, size_t num, const histogram_t* hist, thread_args_t* param) {
+    if (num == 0 && (hist == NULL || hist->total == 0)) {
+        return;
+    }
+
+    uint64_t* diffs = malloc((num > 0 ? num : 1) * sizeof(uint64_t));
+    if (!diffs) {
+        perror("malloc failed");
+        return;
+    }
+    for (size_t i = 0; i < num; i++) {
+        diffs[i] = m[i].diff;
+    }
+
+    jitter_stats_t stats;
+    int ret;
+    if (hist != NULL) {
+        /*
+         * Exact tails need every outlier and every binned interval, otherwise the
+         * ranks of the outliers do not match the histogram. lost is written
+         * before genDone, reading it here is ordered.
+         */
+        const aggregate_t* agg = param->aggregate;
+        size_t outliers = (agg->dropped == 0 && agg->lost == 0) ? num : 0;
+        ret = histogram_stats(hist, diffs, outliers, param->half_period_ns, agg->threshold_ns,
+                              DEADLINE_TOLERANCE_NS, &stats);
+    } else {
+        ret = stats_compute(diffs, num, param->half_period_ns, DEADLINE_TOLERANCE_NS, &stats);
+    }
+
+    if (ret == 0) {
+        char load[64];
+        load_format(param->load_types, load, sizeof(load));
+
+        printf("Jitter [load=%s%s]: samples %zu, p50 %" PRId64 " ns, p99 %" PRId64 " ns, p99.9 %" PRId64
+               " ns, max|abs| %" PRId64 " ns, overruns %zu\n",
+            load, (param->load_types != LOAD_NONE && param->loadAllCores) ? "@all" : "",
+            stats.count, stats.p50, stats.p99, stats.p999, stats.max_abs, stats.overruns);
+    }
+
+    free(diffs);
+}
+
+
 /**
  * @brief Setup GNUPlot for plotting.
  *
@@ -314,10 +431,24 @@ void print_help(const char* progname) {
     printf("Options:\n");
     printf("  -c <cpu core>\t\tSet CPU Core to execute signal generation on\n");
     printf("  -f <freq>\t\tSet signal frequency in Hz\n");
+    printf("  -w <block|poll>\tWait strategy between two toggles\n");
+    printf("  -D <seconds>\t\tStop after <seconds> instead of waiting for Enter\n");
     printf("  -o <filename>\t\tFile to export measurement results\n");
     printf("  -d <gpiochipX:XX>\t\tGPIO Chip and Pin number to output signal to\n");
     printf("  -p <priority>\t\tPriority of the signal generation thread\n");
     printf("  -g \t\t\tPlot live jitter using gnuplot\n");
+    printf("  -t \t\t\tWrite tracepoints to ftrace trace_marker\n");
+    printf("  -b <us>\t\tStop ftrace when a deadline is missed by more than <us>\n");
+    printf("  -i <gpiochipX:XX>\tCapture edges of the signal on a second (loopback) GPIO\n");
+    printf("  -I <filename>\t\tFile to export per-edge capture results\n");
+    printf("  -L <types>\t\tBackground load on non-RT cores: mem,syscall,io[:<dir>],timer or all (io default: cwd)\n");
+    printf("  -A \t\t\tRun background load on all cores, including the RT core\n");
+    printf("  -K <clock>\t\tClock of the edge schedule: mono, raw (only with -w poll), tai\n");
+    printf("  -R <clock>\t\tDiscipline the edge schedule against a reference clock: tai, realtime\n");
+    printf("  -P <filename>\t\tFile to export per-edge phase errors of the schedule\n");
+    printf("  -S <model>\t\tSimulate in virtual time with a wakeup latency model, e.g. normal:2000:500,spike:0.001:50000\n");
+    printf("  -H <us>\t\tAggregate in the generator thread, queue only histograms and intervals deviating more than <us> (not with -o, -g)\n");
+    printf("  -Y <filename>\t\tFile to export the jitter histogram of the aggregation mode\n");
     printf("  -h \t\t\tShow this help message\n");
 }
 
@@ -332,14 +463,30 @@ void parse_user_args(int argc, char* argv[], thread_args_t* targs) {
     targs->gpio = NULL;
     targs->core_id = CPU_CORE;
     targs->half_period_ns = HALF_PERIOD_NS(SIGNAL_FREQ);
+    targs->wait_mode = WAIT_MODE;
+    targs->duration_s = 0;
     targs->sched_prio = SCHED_PRIO;
     targs->doPlot = false;
+    targs->traceMarker = false;
+    targs->break_ns = 0;
+    targs->load_types = LOAD_NONE;
+    targs->loadAllCores = false;
+    strcpy(targs->loadIoDir, LOAD_IO_DIR);
+    targs->clock = SCHEDULE_CLOCK;
+    targs->ref_clock = CLOCK_REALTIME;
+    targs->discipline = false;
+    targs->phaseFile = NULL;
+    targs->simModel = NULL;
+    targs->aggregate_ns = 0;
+    targs->histFile = NULL;
     targs->outputFile = NULL;
+    targs->captureDevice = NULL;
+    targs->captureFile = NULL;
     targs->killswitch = false;
 
     static char filename[64] = {-1};
 
-    while ((opt = getopt(argc, argv, "c:f:d:p:o:gh")) != -1) {
+    while ((opt = getopt(argc, argv, "c:f:w:D:d:p:o:gtb:i:I:L:AK:R:P:S:H:Y:h")) != -1) {
         switch (opt) {
             case 'c':
                 int cpu_core = atoi(optarg);
@@ -355,10 +502,31 @@ void parse_user_args(int argc, char* argv[], thread_args_t* targs) {
                 int signal_freq = atoi(optarg);
                 if (signal_freq <= 0 || signal_freq > MAX_SIGNAL_FREQ) {
                     fprintf(stderr, "Invalid signal frequency. Setting default singal frequency: %dHz\n", SIGNAL_FREQ);
-                    targs->period_ns = PERIOD_NS(SIGNAL_FREQ);
+                    targs->half_period_ns = HALF_PERIOD_NS(SIGNAL_FREQ);
+                    break;
+                }
+                targs->half_period_ns = HALF_PERIOD_NS(signal_freq);
+                break;
+
+            case 'w':
+                if (strcmp(optarg, "block") == 0) {
+                    targs->wait_mode = WAIT_BLOCKING;
+                } else if (strcmp(optarg, "poll") == 0) {
+                    targs->wait_mode = WAIT_POLLING;
+                } else {
+                    fprintf(stderr, "Invalid wait mode. Expected: block or poll\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'D':
+                int duration = atoi(optarg);
+                if (duration <= 0) {
+                    fprintf(stderr, "Invalid duration. Waiting for Enter instead\n");
+                    targs->duration_s = 0;
                     break;
                 }
-                targs->period_ns = PERIOD_NS(signal_freq);
+                targs->duration_s = duration;
                 break;
 
             case 'd':
@@ -419,6 +587,76 @@ void parse_user_args(int argc, char* argv[], thread_args_t* targs) {
                 targs->doPlot = true;
                 break;
 
+            case 't':
+                targs->traceMarker = true;
+                break;
+
+            case 'b':
+                long break_us = atol(optarg);
+                if (break_us <= 0) {
+                    fprintf(stderr, "Invalid breaktrace threshold. Breaktrace disabled\n");
+                    targs->break_ns = 0;
+                    break;
+                }
+                targs->break_ns = (uint64_t)break_us * 1000;
+                break;
+
+            case 'i':
+                targs->captureDevice = optarg;
+                break;
+
+            case 'I':
+                targs->captureFile = optarg;
+                break;
+
+            case 'L':
+                if (load_parse(optarg, &targs->load_types, targs->loadIoDir) != 0) {
+                    fprintf(stderr, "Invalid load. Expected: mem,syscall,io[:<dir>],timer or all\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'A':
+                targs->loadAllCores = true;
+                break;
+
+            case 'K':
+                if (schedule_parse_clock(optarg, &targs->clock) != 0 || targs->clock == CLOCK_REALTIME) {
+                    fprintf(stderr, "Invalid schedule clock. Expected: mono, raw or tai\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+
+            case 'R':
+                if (schedule_parse_clock(optarg, &targs->ref_clock) != 0 ||
+                    (targs->ref_clock != CLOCK_TAI && targs->ref_clock != CLOCK_REALTIME)) {
+                    fprintf(stderr, "Invalid reference clock. Expected: tai or realtime\n");
+                    exit(EXIT_FAILURE);
+                }
+                targs->discipline = true;
+                break;
+
+            case 'P':
+                targs->phaseFile = optarg;
+                break;
+
+            case 'S':
+                targs->simModel = optarg;
+                break;
+
+            case 'H':
+                long aggregate_us = atol(optarg);
+                if (aggregate_us <= 0) {
+                    fprintf(stderr, "Invalid outlier threshold. Expected: <us> > 0\n");
+                    exit(EXIT_FAILURE);
+                }
+                targs->aggregate_ns = (uint64_t)aggregate_us * 1000;
+                break;
+
+            case 'Y':
+                targs->histFile = optarg;
+                break;
+
             case 'h':
                 print_help(argv[0]);
                 exit(EXIT_SUCCESS);
@@ -428,4 +666,16 @@ void parse_user_args(int argc, char* argv[], thread_args_t* targs) {
                 exit(EXIT_FAILURE);
         }
     }
+
+    /* clock_nanosleep() does not support CLOCK_MONOTONIC_RAW, only a polling loop can follow it */
+    if (targs->clock == CLOCK_MONOTONIC_RAW && targs->wait_mode != WAIT_POLLING) {
+        fprintf(stderr, "-K raw requires -w poll, clock_nanosleep() does not support CLOCK_MONOTONIC_RAW\n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* In aggregation mode only the outliers reach the data handler, not every interval */
+    if (targs->aggregate_ns > 0 && (targs->outputFile != NULL || targs->doPlot)) {
+        fprintf(stderr, "-o and -g are not available with -H, use -Y to export the histogram\n");
+        exit(EXIT_FAILURE);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,312 @@
+/**
+ * @file histogram.c
+ *
+ * This file contains the producer-side aggregation: histogram snapshots sent
+ * through the ring buffer, their merge on the consumer side, and statistics
+ * over the merged histogram and the exact outliers.
+ *
+ */
+
+#include "../inc/main.h"
+#include "../inc/histogram.h"
+
+#include <math.h>
+#include <string.h>
+
+
+/**
+ * @brief Initialize the aggregation state of the signal generation thread.
+ *
+ * @param agg The aggregation state.
+ * @param expected_ns The expected interval.
+ * @param threshold_ns Intervals deviating more than this are queued as outliers.
+ */
+void aggregate_init(aggregate_t* agg, uint64_t expected_ns, uint64_t threshold_ns) {
+    memset(agg, 0, sizeof(aggregate_t));
+    agg->expected_ns = expected_ns;
+    agg->threshold_ns = threshold_ns;
+}
+
+
+/**
+ * @brief Queue one snapshot record, if the ring buffer has room for all of it.
+ */
+static bool send_record(aggregate_t* agg, ring_buffer_t* rbuffer, uint64_t* record, size_t entries) {
+    size_t size = (entries + 1) * sizeof(uint64_t);
+    if (RING_BUFFER_MASK(rbuffer) - ring_buffer_num_items(rbuffer) < size) {
+        return false;
+    }
+
+    record[0] = HIST_SNAPSHOT_TAG | entries;
+    ring_buffer_queue_arr(rbuffer, (char*)record, size);
+
+    /* Sent counts start over */
+    for (size_t i = 1; i <= entries; i++) {
+        agg->counts[record[i] >> HIST_COUNT_BITS] = 0;
+    }
+    return true;
+}
+
+
+/**
+ * @brief Send all non-empty histogram buckets since the last snapshot and reset them.
+ *
+ * Runs in the signal generation thread. The snapshot is split into records of
+ * at most HIST_RECORD_ENTRIES buckets; records that do not fit into the ring
+ * buffer keep their counts for the next attempt.
+ *
+ * @return bool true if the whole snapshot was sent.
+ */
+bool aggregate_snapshot(aggregate_t* agg, ring_buffer_t* rbuffer) {
+    uint64_t record[HIST_RECORD_ENTRIES + 1];
+    size_t entries = 0;
+
+    for (size_t slot = 0; slot < HIST_SLOTS; slot++) {
+        if (agg->counts[slot] == 0) {
+            continue;
+        }
+        record[++entries] = ((uint64_t)slot << HIST_COUNT_BITS) | (agg->counts[slot] & HIST_COUNT_MASK);
+
+        if (entries == HIST_RECORD_ENTRIES) {
+            if (!send_record(agg, rbuffer, record, entries)) {
+                return false;
+            }
+            entries = 0;
+        }
+    }
+
+    if (entries > 0 && !send_record(agg, rbuffer, record, entries)) {
+        return false;
+    }
+
+    agg->snapshots++;
+    return true;
+}
+
+
+/**
+ * @brief Send the remaining counts after the main loop.
+ *
+ * Call this from the signal generation thread after the main loop. Waits up to
+ * HIST_FINISH_MS for ring space, then gives up and counts the unsent intervals
+ * as lost (e.g. if the data handler has already exited). Does nothing if
+ * aggregation is disabled (agg == NULL).
+ */
+void aggregate_finish(aggregate_t* agg, ring_buffer_t* rbuffer) {
+    if (agg == NULL) {
+        return;
+    }
+
+    for (unsigned int waited_ms = 0; !aggregate_snapshot(agg, rbuffer); waited_ms++) {
+        if (waited_ms >= HIST_FINISH_MS) {
+            for (size_t slot = 0; slot < HIST_SLOTS; slot++) {
+                agg->lost += agg->counts[slot];
+            }
+            return;
+        }
+        usleep(1000);
+    }
+}
+
+
+/**
+ * @brief Print the ring traffic of the aggregation mode.
+ */
+void aggregate_report(const aggregate_t* agg) {
+    if (agg == NULL || agg->samples == 0) {
+        return;
+    }
+
+    printf("Aggregation [threshold=%" PRIu64 " ns]: %" PRIu64 " samples, %" PRIu64 " outliers, %" PRIu64
+           " snapshots, %" PRIu64 " outliers dropped\n",
+        agg->threshold_ns, agg->samples, agg->outliers, agg->snapshots, agg->dropped);
+    if (agg->lost > 0) {
+        printf("  Final snapshot not drained: %" PRIu64 " intervals missing in the histogram\n", agg->lost);
+    }
+}
+
+
+/**
+ * @brief Add one snapshot entry to the merged histogram of the data handler.
+ */
+void histogram_merge_entry(histogram_t* hist, uint64_t entry) {
+    size_t slot = (size_t)(entry >> HIST_COUNT_BITS);
+    uint64_t count = entry & HIST_COUNT_MASK;
+
+    if (slot < HIST_SLOTS) {
+        hist->counts[slot] += count;
+        hist->total += count;
+    }
+}
+
+
+/**
+ * @brief Jitter of a slot: the signed lower bound of its deviation bucket in ns.
+ */
+int64_t histogram_slot_value(size_t slot) {
+    bool early = slot >= HIST_BUCKETS;
+    size_t bucket = early ? slot - HIST_BUCKETS : slot;
+
+    int64_t dev = (int64_t)bucket;
+    if (bucket >= 2 * HIST_HALF) {
+        size_t shift = bucket / HIST_HALF - 1;
+        dev = (int64_t)((bucket - shift * HIST_HALF) << shift);
+    }
+    return early ? -dev : dev;
+}
+
+
+/**
+ * @brief Slot of a rank in ascending jitter order: early slots descending, then late slots ascending.
+ */
+static inline size_t ordered_slot(size_t i) {
+    return (i < HIST_BUCKETS) ? HIST_SLOTS - 1 - i : i - HIST_BUCKETS;
+}
+
+
+static int compare_int64(const void* a, const void* b) {
+    int64_t x = *(const int64_t*)a;
+    int64_t y = *(const int64_t*)b;
+    return (x > y) - (x < y);
+}
+
+
+/**
+ * @brief Jitter statistics from the merged histogram, exact in the tails.
+ *
+ * The outliers are all intervals deviating more than threshold_ns, so every
+ * rank beyond the threshold is taken from them exactly; ranks in between use
+ * the lower bound of their bucket. Pass num_outliers = 0 if outliers were
+ * dropped. Mean and standard deviation are approximated from the buckets.
+ *
+ * @param hist The merged histogram.
+ * @param outliers The measured intervals of the outliers.
+ * @param num_outliers The number of outliers.
+ * @param expected_ns The expected interval.
+ * @param threshold_ns The outlier threshold.
+ * @param tolerance_ns Intervals longer than expected + tolerance count as overrun.
+ * @param out The statistics.
+ * @return int 0 on success, or -1 if the histogram is empty or on failure.
+ */
+int histogram_stats(const histogram_t* hist, const uint64_t* outliers, size_t num_outliers,
+                    uint64_t expected_ns, uint64_t threshold_ns, uint64_t tolerance_ns,
+                    jitter_stats_t* out) {
+    if (hist->total == 0 || num_outliers > hist->total) {
+        return -1;
+    }
+
+    int64_t* tail = NULL;
+    size_t num_early = 0;
+    if (num_outliers > 0) {
+        tail = malloc(num_outliers * sizeof(int64_t));
+        if (!tail) {
+            perror("malloc failed");
+            return -1;
+        }
+        for (size_t i = 0; i < num_outliers; i++) {
+            tail[i] = (int64_t)outliers[i] - (int64_t)expected_ns;
+            num_early += (tail[i] < 0);
+        }
+        qsort(tail, num_outliers, sizeof(int64_t), compare_int64);
+    }
+    size_t num_late = num_outliers - num_early;
+    size_t n = (size_t)hist->total;
+
+    /* Nearest-rank percentiles, same definition as stats_percentile() */
+    static const double pcts[] = { 50.0, 90.0, 99.0, 99.9 };
+    int64_t* targets[] = { &out->p50, &out->p90, &out->p99, &out->p999 };
+    size_t ranks[4];
+    for (size_t k = 0; k < 4; k++) {
+        size_t rank = (size_t)ceil(pcts[k] / 100.0 * (double)n);
+        ranks[k] = (rank == 0) ? 0 : rank - 1;
+    }
+
+    double sum = 0.0, sum_sq = 0.0;
+    int64_t min = 0, max = 0;
+    bool first = true;
+    uint64_t cum = 0;
+    size_t overruns = 0;
+
+    for (size_t i = 0; i < HIST_SLOTS; i++) {
+        size_t slot = ordered_slot(i);
+        uint64_t c = hist->counts[slot];
+        if (c == 0) {
+            continue;
+        }
+
+        int64_t v = histogram_slot_value(slot);
+        if (first) {
+            min = v;
+            first = false;
+        }
+        max = v;
+        sum += (double)v * (double)c;
+        sum_sq += (double)v * (double)v * (double)c;
+        if (v > (int64_t)tolerance_ns) {
+            overruns += c;
+        }
+
+        for (size_t k = 0; k < 4; k++) {
+            if (ranks[k] >= cum && ranks[k] < cum + c) {
+                *targets[k] = v;
+            }
+        }
+        cum += c;
+    }
+
+    out->count = n;
+    out->mean = sum / (double)n;
+    double var = sum_sq / (double)n - out->mean * out->mean;
+    out->stddev = (var > 0.0) ? sqrt(var) : 0.0;
+
+    /* Replace tail ranks with the exact outliers */
+    for (size_t k = 0; k < 4; k++) {
+        if (ranks[k] < num_early) {
+            *targets[k] = tail[ranks[k]];
+        } else if (ranks[k] >= n - num_late) {
+            *targets[k] = tail[num_early + ranks[k] - (n - num_late)];
+        }
+    }
+    out->min = (num_early > 0) ? tail[0] : min;
+    out->max = (num_late > 0) ? tail[num_outliers - 1] : max;
+    out->max_abs = (-out->min > out->max) ? -out->min : out->max;
+
+    /* Overruns are exact if the threshold does not exceed the tolerance */
+    if (num_outliers > 0 && threshold_ns <= tolerance_ns) {
+        overruns = 0;
+        for (size_t i = num_early; i < num_outliers; i++) {
+            overruns += (tail[i] > (int64_t)tolerance_ns);
+        }
+    }
+    out->overruns = overruns;
+
+    free(tail);
+    return 0;
+}
+
+
+/**
+ * @brief Write the non-empty buckets of the histogram to a CSV file (jitter lower bound, count).
+ *
+ * @param filename The name of the CSV file.
+ * @param hist The merged histogram.
+ */
+void histogram_write(const char* filename, const histogram_t* hist) {
+    if (hist == NULL) {
+        return;
+    }
+
+    FILE* fp = fopen(filename, "w");
+    if (fp == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < HIST_SLOTS; i++) {
+        size_t slot = ordered_slot(i);
+        if (hist->counts[slot] != 0) {
+            fprintf(fp, "%" PRId64 ",%" PRIu64 "\n", histogram_slot_value(slot), hist->counts[slot]);
+        }
+    }
+
+    fclose(fp);
+}
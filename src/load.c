@@ -0,0 +1,376 @@
+/**
+ * @file load.c
+ *
+ * This file contains the background stressors of the load generator: memory
+ * bandwidth / cache thrash, syscall / context switch storms, file I/O with
+ * fsync and timer / IRQ pressure.
+ *
+ */
+
+#include "../inc/main.h"
+#include "../inc/load.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+
+
+typedef struct {
+    load_t*         load;
+    load_type_t     type;
+    int             core_id;
+} stressor_args_t;
+
+static const struct {
+    load_type_t     type;
+    const char*     name;
+} load_names[] = {
+    { LOAD_MEM,     "mem" },
+    { LOAD_SYSCALL, "syscall" },
+    { LOAD_IO,      "io" },
+    { LOAD_TIMER,   "timer" },
+};
+
+#define NUM_LOAD_TYPES (sizeof(load_names) / sizeof(load_names[0]))
+
+
+/**
+ * @brief Parse a comma separated list of load types, e.g. "mem,io" or "io:/var/tmp".
+ *
+ * @param arg The list of load types, "all" for every type. "io:<dir>" selects the
+ *            I/O stressor and the directory of its files.
+ * @param types Bitmask of load_type_t.
+ * @param io_dir Buffer of LOAD_IO_DIR_LEN bytes, set to the directory given with "io:<dir>",
+ *               unchanged otherwise.
+ * @return int 0 on success, or -1 on an unknown load type.
+ */
+int load_parse(const char* arg, unsigned int* types, char* io_dir) {
+    char buf[LOAD_IO_DIR_LEN];
+    if (strlen(arg) >= sizeof(buf)) {
+        fprintf(stderr, "Load argument too long\n");
+        return -1;
+    }
+    strcpy(buf, arg);
+
+    *types = LOAD_NONE;
+    for (char* tok = strtok(buf, ","); tok != NULL; tok = strtok(NULL, ",")) {
+        if (strncmp(tok, "io:", 3) == 0 && tok[3] != '\0') {
+            *types |= LOAD_IO;
+            strcpy(io_dir, tok + 3);
+            continue;
+        }
+        if (strcmp(tok, "all") == 0) {
+            *types = LOAD_MEM | LOAD_SYSCALL | LOAD_IO | LOAD_TIMER;
+            continue;
+        }
+        if (strcmp(tok, "none") == 0) {
+            continue;
+        }
+
+        size_t i;
+        for (i = 0; i < NUM_LOAD_TYPES; i++) {
+            if (strcmp(tok, load_names[i].name) == 0) {
+                *types |= load_names[i].type;
+                break;
+            }
+        }
+        if (i == NUM_LOAD_TYPES) {
+            fprintf(stderr, "Unknown load type: %s\n", tok);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Format a bitmask of load types as comma separated list, "none" if empty.
+ */
+void load_format(unsigned int types, char* buf, size_t len) {
+    size_t pos = 0;
+
+    buf[0] = '\0';
+    for (size_t i = 0; i < NUM_LOAD_TYPES; i++) {
+        if (types & load_names[i].type) {
+            pos += snprintf(buf + pos, (pos < len) ? len - pos : 0, "%s%s", (pos > 0) ? "," : "", load_names[i].name);
+        }
+    }
+    if (pos == 0) {
+        snprintf(buf, len, "none");
+    }
+}
+
+
+/**
+ * @brief Stressor: stream through a buffer larger than the caches, reading and writing every cache line.
+ */
+static void stress_mem(load_t* load) {
+    volatile char* buf = malloc(LOAD_MEM_SIZE);
+    if (!buf) {
+        perror("malloc failed");
+        return;
+    }
+
+    char val = 0;
+    while (!load->stop) {
+        for (size_t i = 0; i < LOAD_MEM_SIZE && !load->stop; i += LOAD_CACHE_LINE) {
+            buf[i] = buf[i] + ++val;
+        }
+    }
+
+    free((void*)buf);
+}
+
+
+/**
+ * @brief Partner thread of the syscall stressor, echoes every byte back.
+ */
+static void* syscall_echo(void* args) {
+    int* fds = args;
+    char c;
+    while (read(fds[0], &c, 1) == 1) {
+        if (write(fds[3], &c, 1) != 1) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Stressor: ping-pong a byte between two threads on the same core through pipes.
+ *
+ * Every round trip costs four syscalls and two context switches.
+ */
+static void stress_syscall(load_t* load, int core_id) {
+    /* fds[0..1]: ping pipe, fds[2..3]: pong pipe */
+    int fds[4];
+    if (pipe(fds) != 0 || pipe(fds + 2) != 0) {
+        perror("pipe failed");
+        return;
+    }
+
+    pthread_t echo;
+    if (pthread_create(&echo, NULL, syscall_echo, fds) != 0) {
+        fprintf(stderr, "Error spawning syscall stressor partner\n");
+        return;
+    }
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core_id, &cpuset);
+    pthread_setaffinity_np(echo, sizeof(cpu_set_t), &cpuset);
+
+    char c = 0;
+    while (!load->stop) {
+        if (write(fds[1], &c, 1) != 1 || read(fds[2], &c, 1) != 1) {
+            break;
+        }
+    }
+
+    /* Closing the ping pipe ends the partner's read loop */
+    close(fds[1]);
+    pthread_join(echo, NULL);
+    close(fds[0]);
+    close(fds[2]);
+    close(fds[3]);
+}
+
+
+/**
+ * @brief Stressor: write blocks to a file and fsync after each of them.
+ */
+static void stress_io(load_t* load) {
+    char path[LOAD_IO_DIR_LEN + 32];
+    snprintf(path, sizeof(path), "%s/rpisignal_load_XXXXXX", load->io_dir);
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp failed");
+        return;
+    }
+    unlink(path);
+
+    char block[LOAD_IO_BLOCK];
+    memset(block, 0xA5, sizeof(block));
+
+    off_t size = 0;
+    while (!load->stop) {
+        if (write(fd, block, sizeof(block)) != sizeof(block)) {
+            perror("write failed");
+            break;
+        }
+        fsync(fd);
+
+        size += sizeof(block);
+        if (size >= (off_t)LOAD_IO_MAX_SIZE) {
+            if (ftruncate(fd, 0) != 0 || lseek(fd, 0, SEEK_SET) != 0) {
+                break;
+            }
+            size = 0;
+        }
+    }
+
+    close(fd);
+}
+
+
+/**
+ * @brief Stressor: arm many timerfds with staggered periods and service every expiry.
+ */
+static void stress_timer(load_t* load) {
+    int epfd = epoll_create1(0);
+    if (epfd < 0) {
+        perror("epoll_create1 failed");
+        return;
+    }
+
+    int fds[LOAD_TIMERS];
+    size_t num = 0;
+    for (size_t i = 0; i < LOAD_TIMERS; i++) {
+        int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+        if (fd < 0) {
+            perror("timerfd_create failed");
+            break;
+        }
+
+        /* Staggered periods so the expiries do not coalesce */
+        uint64_t period = LOAD_TIMER_NS + i * (LOAD_TIMER_NS / LOAD_TIMERS);
+        struct itimerspec its = {
+            .it_interval = { .tv_sec = 0, .tv_nsec = period },
+            .it_value = { .tv_sec = 0, .tv_nsec = period },
+        };
+        struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+        if (timerfd_settime(fd, 0, &its, NULL) != 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            perror("Fehler beim Konfigurieren des timerfd");
+            close(fd);
+            break;
+        }
+        fds[num++] = fd;
+    }
+
+    struct epoll_event events[LOAD_TIMERS];
+    uint64_t expirations;
+    while (!load->stop) {
+        int n = epoll_wait(epfd, events, LOAD_TIMERS, 100);
+        for (int i = 0; i < n; i++) {
+            if (read(events[i].data.fd, &expirations, sizeof(expirations)) < 0) {
+                continue;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < num; i++) {
+        close(fds[i]);
+    }
+    close(epfd);
+}
+
+
+/**
+ * @brief Stressor thread, pinned to a single core.
+ */
+static void* func_stressor(void* args) {
+    stressor_args_t* sargs = args;
+
+    stick_thread_to_core(sargs->core_id);
+
+    switch (sargs->type) {
+        case LOAD_MEM:      stress_mem(sargs->load); break;
+        case LOAD_SYSCALL:  stress_syscall(sargs->load, sargs->core_id); break;
+        case LOAD_IO:       stress_io(sargs->load); break;
+        case LOAD_TIMER:    stress_timer(sargs->load); break;
+        default:            break;
+    }
+
+    free(sargs);
+    return NULL;
+}
+
+
+/**
+ * @brief Start one stressor per load type on every selected core.
+ *
+ * @param types Bitmask of load_type_t.
+ * @param io_dir Directory of the I/O stressor's files.
+ * @param rt_core The core of the signal generation thread.
+ * @param all_cores Also load the signal generation core.
+ * @return load_t* The load context, or NULL on failure or if no load is configured.
+ */
+load_t* load_start(unsigned int types, const char* io_dir, int rt_core, bool all_cores) {
+    if (types == LOAD_NONE) {
+        return NULL;
+    }
+
+    /* fsync() is a no-op on tmpfs, the I/O stressor would only copy memory */
+    struct statfs fs;
+    if ((types & LOAD_IO) && statfs(io_dir, &fs) == 0 && fs.f_type == TMPFS_MAGIC) {
+        fprintf(stderr, "Warning: %s is on tmpfs, the io load does not reach a disk (use io:<dir>)\n", io_dir);
+    }
+
+    load_t* load = calloc(1, sizeof(load_t));
+    if (!load) {
+        perror("Fehler bei calloc");
+        return NULL;
+    }
+    load->io_dir = io_dir;
+    load->stop = false;
+
+    long num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    for (long core = 0; core < num_cores; core++) {
+        if (core == rt_core && !all_cores) {
+            continue;
+        }
+        for (size_t i = 0; i < NUM_LOAD_TYPES; i++) {
+            if (!(types & load_names[i].type)) {
+                continue;
+            }
+            if (load->num_threads >= LOAD_MAX_THREADS) {
+                break;
+            }
+
+            stressor_args_t* sargs = malloc(sizeof(stressor_args_t));
+            if (!sargs) {
+                perror("Fehler bei malloc");
+                load_stop(load);
+                return NULL;
+            }
+            sargs->load = load;
+            sargs->type = load_names[i].type;
+            sargs->core_id = (int)core;
+
+            if (pthread_create(&load->threads[load->num_threads], NULL, func_stressor, sargs) != 0) {
+                fprintf(stderr, "Error spawning stressor thread\n");
+                free(sargs);
+                load_stop(load);
+                return NULL;
+            }
+            load->num_threads++;
+        }
+    }
+
+    char tag[64];
+    load_format(types, tag, sizeof(tag));
+    printf("Load: %s on %s cores (%zu stressor threads)\n", tag,
+        all_cores ? "all" : "non-RT", load->num_threads);
+    if (types & LOAD_IO) {
+        printf("  I/O stressor files in %s\n", io_dir);
+    }
+
+    return load;
+}
+
+
+/**
+ * @brief Stop all stressors and free the load context.
+ */
+void load_stop(load_t* load) {
+    if (load == NULL) {
+        return;
+    }
+
+    load->stop = true;
+    for (size_t i = 0; i < load->num_threads; i++) {
+        pthread_join(load->threads[i], NULL);
+    }
+    free(load);
+}
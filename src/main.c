@@ -4,6 +4,7 @@
 
 #include "../inc/main.h"
 #include "../inc/ringbuffer.h"
+#include "../inc/capture.h"
 
 /**
  * 
@@ -25,6 +26,9 @@ void* func_signal_gen(void* args) {
     /* Store measured time difference as nanoseconds */
     uint64_t time_diff_ns = 0;
 
+    /* Number of the current edge, used by the tracepoints */
+    uint64_t sample = 0;
+
     /**
      * 
      * Your Code goes here...
@@ -33,6 +37,9 @@ void* func_signal_gen(void* args) {
 
 
 
+    /* Anchor the absolute edge schedule, edge 0 is due one half period from now */
+    schedule_start(param->schedule);
+
     /* Main loop for signal generation and time measurement. */
     while (!param->killswitch) {
 
@@ -41,13 +48,51 @@ void* func_signal_gen(void* args) {
          * 
          * Your Code goes here... 
          * 
+         * Select the wait strategy with param->wait_mode (-w block|poll).
+         * 
+         * Use sim_clock_gettime(), sim_clock_nanosleep() and sim_gpio_set_value()
+         * (see sim.h) instead of the plain calls, so the loop also runs in
+         * virtual time in simulation mode (-S).
+         * 
+         * Absolute edge schedule (see schedule.h) on clock param->schedule->clock:
+         *  - schedule_next(param->schedule, &deadline) for the deadline of the next edge
+         *  - schedule_record(param->schedule, &ts) with the timestamp of the toggle
+         * 
+         * Tracepoints for kernel tracers (see trace.h), not called by this
+         * template - only trace_deadline() below is:
+         *  - trace_wake(sample) directly after waking up for the next edge
+         *  - trace_edge(sample, value) directly after gpiod_line_set_value()
+         * 
+         * Edge capture (see capture.h), does nothing unless started with -i:
+         *  - capture_edge(param->capture, &ts, &deadline, value) with the timestamp
+         *    taken directly before gpiod_line_set_value() and the deadline of the edge.
+         *    Capture requires the schedule clock to be CLOCK_MONOTONIC, so the same
+         *    ts can be passed to schedule_record()
+         * 
          */
 
 
-        /* Write measured time difference to ringbuffer */
-        WRITE_TO_RINGBUFFER(param->rbuffer, time_diff_ns);
+        /* Report deadline misses to USDT / ftrace, stop tracing on breaktrace threshold */
+        trace_deadline(sample, time_diff_ns, param->half_period_ns);
+
+        /* Write measured time difference to ringbuffer, or only histogram and outliers in aggregation mode */
+        if (param->aggregate != NULL) {
+            aggregate_sample(param->aggregate, param->rbuffer, time_diff_ns);
+        } else {
+            WRITE_TO_RINGBUFFER(param->rbuffer, time_diff_ns);
+        }
+        sample++;
     }
 
+    /* Send the last histogram snapshot - only in aggregation mode */
+    aggregate_finish(param->aggregate, param->rbuffer);
+
+    /* CPU time and context switches of this thread alone, the process usage includes the stressors */
+    getrusage(RUSAGE_THREAD, &param->genUsage);
+
+    /* Everything is queued, the data handler can do its final drain */
+    __atomic_store_n(&param->genDone, true, __ATOMIC_RELEASE);
+
     pthread_exit(NULL);
 }
 
@@ -60,24 +105,101 @@ int main(int argc, char** argv) {
     thread_args_t targs;
     parse_user_args(argc, argv, &targs);
 
+    /* Virtual time instead of clock, sleep and GPIO - only if configured */
+    static gpio_handle_t sim_gpio = { .chip = NULL, .line = NULL };
+    if (targs.simModel != NULL) {
+        if (sim_init(targs.simModel) != 0) {
+            fprintf(stderr, "Invalid simulation latency model\n");
+            return EXIT_FAILURE;
+        }
+        if (targs.captureDevice != NULL) {
+            fprintf(stderr, "Edge capture is not available in simulation mode\n");
+            return EXIT_FAILURE;
+        }
+        if (targs.gpio == NULL) {
+            targs.gpio = &sim_gpio;
+        }
+    }
+
     /* initialize GPIO Port with default from config.h */
     if (targs.gpio == NULL) {
         targs.gpio = init_gpio(GPIO_PIN, GPIO_CHIP);
     }
 
+    /* Open tracefs files before the hot path starts */
+    if (trace_init(targs.traceMarker, targs.break_ns) != 0) {
+        fprintf(stderr, "Error initializing ftrace integration\n");
+        return EXIT_FAILURE;
+    }
+
     /* Initialize ringbuffer for storing time measurement results */
     size_t buffer_size = RING_BUFFER_SIZE * sizeof(uint64_t);
     char buffer[buffer_size];
     ring_buffer_t ring_buffer;
     ring_buffer_init(&ring_buffer, buffer, buffer_size);
 
+    /* Absolute edge schedule for drift tracking */
+    static schedule_t schedule;
+    schedule_init(&schedule, targs.clock, targs.half_period_ns, targs.discipline, targs.ref_clock);
+
     /* configure thread arguments */
     targs.rbuffer = &ring_buffer;
+    targs.schedule = &schedule;
+
+    /* The virtual clock waits for the consumers instead of dropping samples */
+    if (sim_active) {
+        sim_register_ring(&ring_buffer);
+        sim_register_ring(&schedule.rbuffer);
+        if (targs.duration_s > 0) {
+            sim_set_duration((int64_t)targs.duration_s * (int64_t)SEC_IN_NS);
+        }
+    }
     targs.killswitch = 0;
+    targs.genDone = false;
+
+    /* Aggregate in the signal generation thread - only if configured */
+    static aggregate_t aggregate;
+    targs.aggregate = NULL;
+    if (targs.aggregate_ns > 0) {
+        aggregate_init(&aggregate, targs.half_period_ns, targs.aggregate_ns);
+        targs.aggregate = &aggregate;
+    }
+
+    /* Request capture line for loopback measurement - only if configured */
+    targs.capture = NULL;
+    if (targs.captureDevice != NULL) {
+        if (targs.clock != CLOCK_MONOTONIC) {
+            fprintf(stderr, "Edge capture requires the schedule clock mono (kernel edge timestamps)\n");
+            return EXIT_FAILURE;
+        }
+        targs.capture = capture_init(targs.captureDevice, targs.half_period_ns);
+        if (targs.capture == NULL) {
+            fprintf(stderr, "Capture-GPIO-Initialisierung fehlgeschlagen\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* Start background load before the generator, so it is already settled - only if configured */
+    load_t* load = load_start(targs.load_types, targs.loadIoDir, targs.core_id, targs.loadAllCores);
+    if (targs.load_types != LOAD_NONE && load == NULL) {
+        fprintf(stderr, "Error starting background load\n");
+        return EXIT_FAILURE;
+    }
 
     /* Create and start worker threads */
-    pthread_t worker_signal_gen, worker_data_handler;
-    int ret = pthread_create(&worker_signal_gen, NULL, &func_signal_gen, &targs);
+    pthread_t worker_signal_gen, worker_data_handler, worker_capture;
+    int ret;
+
+    /* Capture reader first, the kernel holds only 16 events until someone reads them */
+    if (targs.capture != NULL) {
+        ret = pthread_create(&worker_capture, NULL, &func_capture, &targs);
+        if (ret != 0) {
+            fprintf(stderr, "Error spawning Capture-Thread\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    ret = pthread_create(&worker_signal_gen, NULL, &func_signal_gen, &targs);
     if (ret != 0) {
         fprintf(stderr, "Error spawning Worker-Thread\n");
         return EXIT_FAILURE;
@@ -89,17 +211,56 @@ int main(int argc, char** argv) {
         return EXIT_FAILURE;
     }
 
-    /* Wait for user input to stop the program */
-    printf("Press Enter to stop...\n");
-    getchar();
+    /* Wait for user input or the configured duration to stop the program */
+    int status = EXIT_SUCCESS;
+    if (targs.duration_s > 0 && sim_active) {
+        /* Duration is virtual time in simulation mode, give up if it stalls */
+        int64_t last_ns = -1;
+        unsigned int stalled_ms = 0;
+        while (sim_elapsed_ns() < (int64_t)targs.duration_s * (int64_t)SEC_IN_NS) {
+            usleep(SIM_REFRESH_US);
+            int64_t now_ns = sim_elapsed_ns();
+            stalled_ms = (now_ns == last_ns) ? stalled_ms + SIM_REFRESH_US / 1000 : 0;
+            last_ns = now_ns;
+            if (stalled_ms >= SIM_STALL_MS) {
+                fprintf(stderr, "Virtual time does not advance: the generator loop must use the sim_* wrappers (see sim.h)\n");
+                status = EXIT_FAILURE;
+                break;
+            }
+        }
+    } else if (targs.duration_s > 0) {
+        sleep(targs.duration_s);
+    } else {
+        printf("Press Enter to stop...\n");
+        getchar();
+    }
     targs.killswitch = 1;
+    sim_stop();
 
     pthread_join(worker_signal_gen, NULL);
     pthread_join(worker_data_handler, NULL);
+    load_stop(load);
+    schedule_report(&schedule);
+    aggregate_report(targs.aggregate);
+    printf(GEN_USAGE_FORMAT,
+        targs.genUsage.ru_utime.tv_sec * 1e3 + targs.genUsage.ru_utime.tv_usec / 1e3,
+        targs.genUsage.ru_stime.tv_sec * 1e3 + targs.genUsage.ru_stime.tv_usec / 1e3,
+        targs.genUsage.ru_nvcsw, targs.genUsage.ru_nivcsw);
+    sim_report();
+
+    if (targs.capture != NULL) {
+        pthread_join(worker_capture, NULL);
+        capture_report(targs.capture, targs.captureFile);
+        capture_free(targs.capture);
+    }
 
     /* Clean up */
-    gpiod_chip_close(targs.gpio->chip);
-    free(targs.gpio);
+    trace_close();
+    if (targs.gpio != &sim_gpio) {
+        gpiod_chip_close(targs.gpio->chip);
+        free(targs.gpio);
+    }
+    sim_free();
 
-    return EXIT_SUCCESS;
+    return status;
 }
\ No newline at end of file
@@ -0,0 +1,87 @@
+/**
+ * @file platform.c
+ * 
+ * This file contains helper functions for GPIO initialization and thread management,
+ * shared between RPISignal and the benchmark tools. Change at your own risk.
+ * 
+ */
+
+#include "../inc/main.h"
+
+
+/**
+ * @brief Initialize the GPIO port and return a handle.
+ *
+ * @param gpio_pin The GPIO pin number.
+ * @param gpio_chip The GPIO chip name.
+ * @return gpio_handle_t* Pointer to the GPIO handle, or NULL on failure.
+ */
+gpio_handle_t* init_gpio(int gpio_pin, const char* gpio_chip) {
+    gpio_handle_t* handle = malloc(sizeof(gpio_handle_t));
+    if (!handle) {
+        perror("Fehler bei malloc");
+        return NULL;
+    }
+
+    if (gpio_chip == NULL) {
+        perror("Fehler, kein GPIO Chip gegeben. Nutze gpioinfo, um herauszufinden welchen chip du benötigst");
+        free(handle);
+        return NULL;
+    }
+    handle->chip = gpiod_chip_open(gpio_chip);
+    if (!handle->chip) {
+        perror("Fehler beim Öffnen des GPIO-Chips");
+        free(handle);
+        return NULL;
+    }
+    handle->line = gpiod_chip_get_line(handle->chip, gpio_pin);
+    if (!handle->line) {
+        perror("Fehler beim Abrufen der GPIO-Leitung");
+        gpiod_chip_close(handle->chip);
+        free(handle);
+        return NULL;
+    }
+    if (gpiod_line_request_output(handle->line, "RPiSignal", 0) < 0) {
+        perror("Fehler bei der Konfiguration der GPIO-Leitung als Ausgang");
+        gpiod_chip_close(handle->chip);
+        free(handle);
+        return NULL;
+    }
+    return handle;
+}
+
+
+/**
+ * @brief Bind the thread to a specific CPU core.
+ *
+ * @param core_id The CPU core ID.
+ * @return int 0 on success, or an error code on failure.
+ */
+int stick_thread_to_core(int core_id) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core_id, &cpuset);
+
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+    if(ret != 0) {
+        perror("Fehler beim Setzen der CPU-Affinität\n");
+    }
+    return ret;
+}
+
+
+/**
+ * @brief Set thread priority (if needed).
+ *
+ * @param priority The thread priority.
+ * @return int 0 on success, or an error code on failure.
+ */
+int set_thread_priority(int priority) {
+    struct sched_param schedParam;
+    schedParam.sched_priority = priority;
+    int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &schedParam);
+    if(ret != 0) {
+        perror("Fehler beim Setzen des Echtzeit-Schedulings");
+    }
+    return ret;
+}
@@ -0,0 +1,233 @@
+/**
+ * @file schedule.c
+ *
+ * This file contains the absolute edge schedule: ideal edge times anchored at
+ * start, per-edge phase error and drift statistics, and the PI servo that
+ * disciplines the schedule against a reference clock.
+ *
+ */
+
+#include "../inc/main.h"
+#include "../inc/schedule.h"
+#include "../inc/sim.h"
+
+#include <string.h>
+
+
+static const struct {
+    clockid_t       clock;
+    const char*     name;
+} clock_names[] = {
+    { CLOCK_MONOTONIC,      "mono" },
+    { CLOCK_MONOTONIC_RAW,  "raw" },
+    { CLOCK_TAI,            "tai" },
+    { CLOCK_REALTIME,       "realtime" },
+};
+
+#define NUM_CLOCKS (sizeof(clock_names) / sizeof(clock_names[0]))
+
+
+static inline int64_t timespec_to_ns(const struct timespec* ts) {
+    return (int64_t)ts->tv_sec * (int64_t)SEC_IN_NS + ts->tv_nsec;
+}
+
+static inline int64_t read_clock_ns(clockid_t clock) {
+    struct timespec ts;
+    sim_clock_gettime(clock, &ts);
+    return timespec_to_ns(&ts);
+}
+
+
+/**
+ * @brief Parse a clock name (mono, raw, tai, realtime).
+ *
+ * @return int 0 on success, or -1 on an unknown clock.
+ */
+int schedule_parse_clock(const char* name, clockid_t* clock) {
+    for (size_t i = 0; i < NUM_CLOCKS; i++) {
+        if (strcmp(name, clock_names[i].name) == 0) {
+            *clock = clock_names[i].clock;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+
+/**
+ * @brief Name of a clock as accepted by schedule_parse_clock().
+ */
+const char* schedule_clock_name(clockid_t clock) {
+    for (size_t i = 0; i < NUM_CLOCKS; i++) {
+        if (clock_names[i].clock == clock) {
+            return clock_names[i].name;
+        }
+    }
+    return "unknown";
+}
+
+
+/**
+ * @brief Initialize the schedule. The anchor is set by schedule_start().
+ *
+ * @param s The schedule.
+ * @param clock The clock of the schedule.
+ * @param half_period_ns Ideal time between two edges.
+ * @param discipline Discipline the schedule against ref_clock.
+ * @param ref_clock The reference clock.
+ */
+void schedule_init(schedule_t* s, clockid_t clock, uint64_t half_period_ns,
+                   bool discipline, clockid_t ref_clock) {
+    memset(s, 0, sizeof(schedule_t));
+    s->clock = clock;
+    s->half_period_ns = half_period_ns;
+    s->discipline = discipline;
+    s->ref_clock = ref_clock;
+    s->phase_max_ns = INT64_MIN;
+    s->phase_min_ns = INT64_MAX;
+    ring_buffer_init(&s->rbuffer, s->ring_buf, sizeof(s->ring_buf));
+}
+
+
+/**
+ * @brief Anchor the schedule: edge 0 is due one half period from now.
+ *
+ * Call this from the signal generation thread right before the main loop.
+ */
+void schedule_start(schedule_t* s) {
+    int64_t now = read_clock_ns(s->clock);
+
+    if (s->discipline) {
+        s->ref_offset0_ns = read_clock_ns(s->ref_clock) - now;
+    }
+    s->anchor_ns = now + (int64_t)s->half_period_ns;
+    s->edge = 0;
+}
+
+
+/**
+ * @brief Correction of the schedule at a time since anchor, as predicted by the servo.
+ */
+static inline int64_t servo_correction(const schedule_t* s, int64_t t_ns) {
+    return (int64_t)(s->servo_corr_ns + s->servo_rate * (double)(t_ns - s->servo_last_ns));
+}
+
+
+/**
+ * @brief Ideal time of an edge on the schedule clock.
+ */
+static inline int64_t ideal_ns(const schedule_t* s, uint64_t edge) {
+    int64_t t = (int64_t)(edge * s->half_period_ns);
+    if (s->discipline) {
+        t -= servo_correction(s, t);
+    }
+    return s->anchor_ns + t;
+}
+
+
+/**
+ * @brief Absolute deadline of the next edge on the schedule clock.
+ *
+ * Use with clock_nanosleep(s->clock, TIMER_ABSTIME, ...) or for polling.
+ * Note that clock_nanosleep() does not support CLOCK_MONOTONIC_RAW, parse_user_args()
+ * therefore only accepts -K raw together with -w poll.
+ */
+void schedule_next(schedule_t* s, struct timespec* deadline) {
+    int64_t t = ideal_ns(s, s->edge);
+    deadline->tv_sec = t / (int64_t)SEC_IN_NS;
+    deadline->tv_nsec = t % (int64_t)SEC_IN_NS;
+}
+
+
+/**
+ * @brief Update the servo with the current offset between reference and schedule clock.
+ */
+static void servo_update(schedule_t* s, int64_t t_ns) {
+    /* Take the schedule clock before and after the reference to center the measurement */
+    int64_t s1 = read_clock_ns(s->clock);
+    int64_t ref = read_clock_ns(s->ref_clock);
+    int64_t s2 = read_clock_ns(s->clock);
+    double measured = (double)(ref - (s1 + (s2 - s1) / 2) - s->ref_offset0_ns);
+
+    double dt = (double)(t_ns - s->servo_last_ns);
+    double predicted = s->servo_corr_ns + s->servo_rate * dt;
+    double err = measured - predicted;
+
+    s->servo_corr_ns = predicted + SCHEDULE_SERVO_KP * err;
+    s->servo_rate += SCHEDULE_SERVO_KI * err / dt;
+    s->servo_last_ns = t_ns;
+}
+
+
+/**
+ * @brief Record the time at which the current edge was actually set and advance to the next edge.
+ *
+ * Call this from the signal generation thread with the timestamp of the toggle,
+ * taken on the schedule clock.
+ *
+ * @param s The schedule.
+ * @param actual Time the edge was set.
+ * @return int64_t Phase error of the edge (actual - ideal) in ns.
+ */
+int64_t schedule_record(schedule_t* s, const struct timespec* actual) {
+    int64_t ideal = ideal_ns(s, s->edge);
+    int64_t err = timespec_to_ns(actual) - ideal;
+
+    s->phase_err_ns = err;
+    if (err > s->phase_max_ns) s->phase_max_ns = err;
+    if (err < s->phase_min_ns) s->phase_min_ns = err;
+
+    /* Online least-squares regression of phase error (ns) over time (s) */
+    double t = (double)(ideal - s->anchor_ns) / (double)SEC_IN_NS;
+    s->count++;
+    double dt = t - s->mean_t;
+    s->mean_t += dt / (double)s->count;
+    s->mean_err += ((double)err - s->mean_err) / (double)s->count;
+    s->m2_t += dt * (t - s->mean_t);
+    s->c_t_err += dt * ((double)err - s->mean_err);
+
+    /* The ring buffer drops bytes when full, only queue complete words */
+    if (RING_BUFFER_MASK((&s->rbuffer)) - ring_buffer_num_items(&s->rbuffer) >= sizeof(int64_t)) {
+        WRITE_PHASE_TO_RINGBUFFER(&s->rbuffer, err);
+    } else {
+        s->dropped++;
+    }
+
+    s->edge++;
+
+    if (s->discipline) {
+        int64_t next = (int64_t)(s->edge * s->half_period_ns);
+        if (next - s->servo_last_ns >= SCHEDULE_SERVO_NS) {
+            servo_update(s, next);
+        }
+    }
+
+    return err;
+}
+
+
+/**
+ * @brief Print the drift rate and the phase deviation of the run.
+ */
+void schedule_report(schedule_t* s) {
+    if (s->count == 0) {
+        return;
+    }
+
+    int64_t max_dev = (-s->phase_min_ns > s->phase_max_ns) ? -s->phase_min_ns : s->phase_max_ns;
+    printf("Schedule [clock=%s%s%s]: %" PRIu64 " edges over %.1f s\n", schedule_clock_name(s->clock),
+        s->discipline ? ", disciplined to " : "", s->discipline ? schedule_clock_name(s->ref_clock) : "",
+        s->count, (double)((s->count - 1) * s->half_period_ns) / (double)SEC_IN_NS);
+    printf("  Phase error:  last %" PRId64 " ns, min %" PRId64 " ns, max %" PRId64 " ns, max|dev| %" PRId64 " ns\n",
+        s->phase_err_ns, s->phase_min_ns, s->phase_max_ns, max_dev);
+    if (s->m2_t > 0.0) {
+        printf("  Drift rate:   %.3f ns/s (ppb)\n", s->c_t_err / s->m2_t);
+    }
+    if (s->dropped > 0) {
+        printf("  Export:       %" PRIu64 " phase errors dropped (ring buffer full)\n", s->dropped);
+    }
+    if (s->discipline) {
+        printf("  Servo:        correction %.0f ns, frequency %.3f ppb\n",
+            s->servo_corr_ns, s->servo_rate * 1e9);
+    }
+}
@@ -0,0 +1,344 @@
+/**
+ * @file sim.c
+ *
+ * This file contains the virtual-time simulation mode: the virtual clock, the
+ * wakeup latency models and the backpressure on the consumer pipeline.
+ *
+ */
+
+#include "../inc/main.h"
+#include "../inc/sim.h"
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+
+#define SIM_MAX_COMPONENTS  8
+
+typedef enum {
+    SIM_CONST,
+    SIM_UNIFORM,
+    SIM_NORMAL,
+    SIM_EXP,
+    SIM_SPIKE,
+    SIM_REPLAY,
+} sim_model_type_t;
+
+typedef struct {
+    sim_model_type_t    type;
+    double              a;
+    double              b;
+} sim_component_t;
+
+bool sim_active = false;
+
+/* Virtual time, written by the signal generation thread only */
+static int64_t sim_now_ns = SIM_EPOCH_NS;
+
+static sim_component_t components[SIM_MAX_COMPONENTS];
+static size_t num_components = 0;
+
+static int64_t* replay = NULL;
+static size_t replay_count = 0;
+static size_t replay_pos = 0;
+
+static ring_buffer_t* rings[SIM_MAX_RINGS];
+static size_t num_rings = 0;
+
+/* Set once the consumers stop, disables the backpressure */
+static volatile bool stopping = false;
+
+/* Virtual time at which the generator is held until sim_stop(), 0 if unlimited */
+static int64_t end_ns = 0;
+
+static uint64_t rng_state = SIM_SEED;
+static struct timespec real_start;
+static uint64_t sleeps = 0;
+
+
+/**
+ * @brief xorshift64* pseudo random number generator.
+ */
+static inline uint64_t next_random(void) {
+    uint64_t x = rng_state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    rng_state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ * @brief Uniformly distributed random number in (0, 1).
+ */
+static inline double next_uniform(void) {
+    return ((double)(next_random() >> 11) + 0.5) / 9007199254740992.0;
+}
+
+
+/**
+ * @brief Load per-edge phase errors exported with -P as wakeup latencies.
+ *
+ * A phase error is the lateness of an edge against its ideal time, so it can
+ * be replayed directly. Early edges (negative phase error) replay as 0.
+ *
+ * @return int 0 on success, or -1 on failure.
+ */
+static int load_replay(const char* filename) {
+    FILE* fp = fopen(filename, "r");
+    if (fp == NULL) {
+        perror(filename);
+        return -1;
+    }
+
+    size_t capacity = 0;
+    int64_t phase;
+    replay_count = 0;
+    while (fscanf(fp, "%" SCNd64, &phase) == 1) {
+        if (replay_count >= capacity) {
+            capacity = (capacity == 0) ? 1024 : capacity * 2;
+            int64_t* temp = realloc(replay, capacity * sizeof(int64_t));
+            if (!temp) {
+                perror("realloc failed");
+                fclose(fp);
+                return -1;
+            }
+            replay = temp;
+        }
+        replay[replay_count++] = (phase > 0) ? phase : 0;
+    }
+    fclose(fp);
+
+    if (replay_count == 0) {
+        fprintf(stderr, "No phase errors in %s\n", filename);
+        return -1;
+    }
+    replay_pos = 0;
+    return 0;
+}
+
+
+/**
+ * @brief Parse the latency model and activate simulation mode.
+ *
+ * @param model The latency model, see sim.h.
+ * @return int 0 on success, or -1 on an invalid model.
+ */
+int sim_init(const char* model) {
+    char buf[256];
+    strncpy(buf, model, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+
+    num_components = 0;
+    char* save = NULL;
+    for (char* tok = strtok_r(buf, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)) {
+        if (num_components >= SIM_MAX_COMPONENTS) {
+            fprintf(stderr, "Too many latency model components\n");
+            return -1;
+        }
+        sim_component_t* c = &components[num_components];
+        c->a = 0.0;
+        c->b = 0.0;
+
+        if (strncmp(tok, "replay:", 7) == 0) {
+            if (replay_count != 0 || load_replay(tok + 7) != 0) {
+                return -1;
+            }
+            c->type = SIM_REPLAY;
+        } else if (sscanf(tok, "const:%lf", &c->a) == 1) {
+            c->type = SIM_CONST;
+        } else if (sscanf(tok, "uniform:%lf:%lf", &c->a, &c->b) == 2 && c->b >= c->a) {
+            c->type = SIM_UNIFORM;
+        } else if (sscanf(tok, "normal:%lf:%lf", &c->a, &c->b) == 2) {
+            c->type = SIM_NORMAL;
+        } else if (sscanf(tok, "exp:%lf", &c->a) == 1) {
+            c->type = SIM_EXP;
+        } else if (sscanf(tok, "spike:%lf:%lf", &c->a, &c->b) == 2 && c->a >= 0.0 && c->a <= 1.0) {
+            c->type = SIM_SPIKE;
+        } else {
+            fprintf(stderr, "Invalid latency model component: %s\n", tok);
+            return -1;
+        }
+        num_components++;
+    }
+
+    sim_now_ns = SIM_EPOCH_NS;
+    rng_state = SIM_SEED;
+    sleeps = 0;
+    stopping = false;
+    end_ns = 0;
+    clock_gettime(CLOCK_MONOTONIC, &real_start);
+    sim_active = true;
+
+    printf("Simulation mode: virtual time, wakeup latency model '%s'\n", model);
+    return 0;
+}
+
+
+/**
+ * @brief Apply backpressure from a ring buffer: the virtual clock does not advance while it is full.
+ */
+void sim_register_ring(ring_buffer_t* rbuffer) {
+    if (num_rings < SIM_MAX_RINGS) {
+        rings[num_rings++] = rbuffer;
+    }
+}
+
+
+/**
+ * @brief Hold the generator once the given virtual duration has elapsed, until sim_stop().
+ */
+void sim_set_duration(int64_t duration_ns) {
+    end_ns = SIM_EPOCH_NS + duration_ns;
+}
+
+
+/**
+ * @brief Release the backpressure, so the signal generation thread can terminate without consumers.
+ */
+void sim_stop(void) {
+    stopping = true;
+}
+
+
+/**
+ * @brief Draw the next wakeup latency from the model.
+ */
+static int64_t next_latency(void) {
+    double latency = 0.0;
+
+    for (size_t i = 0; i < num_components; i++) {
+        const sim_component_t* c = &components[i];
+        switch (c->type) {
+            case SIM_CONST:
+                latency += c->a;
+                break;
+            case SIM_UNIFORM:
+                latency += c->a + (c->b - c->a) * next_uniform();
+                break;
+            case SIM_NORMAL:
+                /* Box-Muller */
+                latency += c->a + c->b * sqrt(-2.0 * log(next_uniform())) * cos(2.0 * M_PI * next_uniform());
+                break;
+            case SIM_EXP:
+                latency += -c->a * log(next_uniform());
+                break;
+            case SIM_SPIKE:
+                if (next_uniform() < c->a) {
+                    latency += c->b;
+                }
+                break;
+            case SIM_REPLAY:
+                latency += (double)replay[replay_pos];
+                replay_pos = (replay_pos + 1) % replay_count;
+                break;
+        }
+    }
+
+    return (latency > 0.0) ? (int64_t)latency : 0;
+}
+
+
+/**
+ * @brief Wait until all registered ring buffers have room again.
+ */
+static void wait_for_consumer(void) {
+    for (size_t i = 0; i < num_rings; i++) {
+        while (!stopping && (RING_BUFFER_MASK(rings[i]) - ring_buffer_num_items(rings[i])) < SIM_RING_HEADROOM) {
+            sched_yield();
+        }
+    }
+
+    /* Do not run ahead of the configured duration while main() has not noticed it yet */
+    while (!stopping && end_ns > 0 && sim_now_ns >= end_ns) {
+        sched_yield();
+    }
+}
+
+
+static inline void set_now(int64_t now) {
+    __atomic_store_n(&sim_now_ns, now, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * @brief Virtual clock_gettime(). Every call costs SIM_CLOCK_COST_NS of virtual time.
+ */
+int sim_virtual_gettime(struct timespec* ts) {
+    int64_t now = sim_now_ns + SIM_CLOCK_COST_NS;
+    set_now(now);
+    ts->tv_sec = now / (int64_t)SEC_IN_NS;
+    ts->tv_nsec = now % (int64_t)SEC_IN_NS;
+    return 0;
+}
+
+
+/**
+ * @brief Virtual clock_nanosleep(): advance virtual time to the deadline plus a wakeup latency.
+ */
+int sim_virtual_sleep(int flags, const struct timespec* req) {
+    if (req->tv_nsec < 0 || req->tv_nsec >= (long)SEC_IN_NS) {
+        return EINVAL;
+    }
+
+    int64_t target = (int64_t)req->tv_sec * (int64_t)SEC_IN_NS + req->tv_nsec;
+    if (!(flags & TIMER_ABSTIME)) {
+        target += sim_now_ns;
+    }
+
+    int64_t now = (target > sim_now_ns) ? target : sim_now_ns;
+    set_now(now + next_latency());
+    sleeps++;
+    return 0;
+}
+
+
+/**
+ * @brief Virtual gpiod_line_set_value(). Blocks while a registered ring buffer is full.
+ */
+int sim_virtual_gpio(int value) {
+    (void)value;
+
+    /* Once per edge, independent of the wait strategy */
+    wait_for_consumer();
+
+    set_now(sim_now_ns + SIM_GPIO_COST_NS);
+    return 0;
+}
+
+
+/**
+ * @brief Virtual time elapsed since the start of the simulation.
+ */
+int64_t sim_elapsed_ns(void) {
+    return __atomic_load_n(&sim_now_ns, __ATOMIC_RELAXED) - SIM_EPOCH_NS;
+}
+
+
+/**
+ * @brief Print virtual and real duration of the simulation.
+ */
+void sim_report(void) {
+    if (!sim_active) {
+        return;
+    }
+
+    struct timespec real_end;
+    clock_gettime(CLOCK_MONOTONIC, &real_end);
+    double real_s = (double)timespec_delta_nanoseconds(&real_end, &real_start) / (double)SEC_IN_NS;
+    double virtual_s = (double)sim_elapsed_ns() / (double)SEC_IN_NS;
+
+    printf("Simulation: %.1f s virtual time in %.2f s real time (%.0fx), %" PRIu64 " sleeps\n",
+        virtual_s, real_s, (real_s > 0.0) ? virtual_s / real_s : 0.0, sleeps);
+}
+
+
+/**
+ * @brief Release the replay buffer.
+ */
+void sim_free(void) {
+    free(replay);
+    replay = NULL;
+    replay_count = 0;
+}
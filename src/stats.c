@@ -0,0 +1,375 @@
+/**
+ * @file stats.c
+ *
+ * This file contains functions to load recorded toggle intervals and compute
+ * jitter statistics (percentiles, max, mean, standard deviation) over them.
+ *
+ */
+
+#include "../inc/stats.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#define INITIAL_CAPACITY 1024
+#define CAPACITY_MULTIPLIER 2
+
+
+static int compare_int64(const void* a, const void* b) {
+    int64_t x = *(const int64_t*)a;
+    int64_t y = *(const int64_t*)b;
+    return (x > y) - (x < y);
+}
+
+
+/**
+ * @brief 0-based index of the nearest-rank percentile in a sorted array of <count> values.
+ */
+static size_t nearest_rank_index(size_t count, double pct) {
+    size_t rank = (size_t)ceil(pct / 100.0 * (double)count);
+    if (rank == 0) {
+        rank = 1;
+    }
+    if (rank > count) {
+        rank = count;
+    }
+    return rank - 1;
+}
+
+
+/**
+ * @brief Load toggle intervals from a CSV file as written by RPISignal (-o).
+ *
+ * @param filename The name of the CSV file.
+ * @param diffs Pointer to the allocated array of intervals, to be freed by the caller.
+ * @param count Pointer to the number of intervals.
+ * @return int 0 on success, or -1 on failure.
+ */
+int stats_load_csv(const char* filename, uint64_t** diffs, size_t* count) {
+    FILE* fp = fopen(filename, "r");
+    if (fp == NULL) {
+        perror(filename);
+        return -1;
+    }
+
+    uint64_t* values = NULL;
+    size_t num = 0, capacity = 0;
+    uint64_t diff;
+
+    while (fscanf(fp, "%" SCNu64, &diff) == 1) {
+        if (num >= capacity) {
+            size_t new_capacity = (capacity == 0) ? INITIAL_CAPACITY : (capacity * CAPACITY_MULTIPLIER);
+            uint64_t* temp = realloc(values, new_capacity * sizeof(uint64_t));
+            if (!temp) {
+                perror("realloc failed");
+                free(values);
+                fclose(fp);
+                return -1;
+            }
+            values = temp;
+            capacity = new_capacity;
+        }
+        values[num++] = diff;
+    }
+
+    fclose(fp);
+    *diffs = values;
+    *count = num;
+    return 0;
+}
+
+
+/**
+ * @brief Nearest-rank percentile of a sorted array.
+ *
+ * @param sorted The sorted values.
+ * @param count The number of values, must be > 0.
+ * @param pct The percentile in the range [0, 100].
+ * @return int64_t The value at the requested percentile.
+ */
+int64_t stats_percentile(const int64_t* sorted, size_t count, double pct) {
+    return sorted[nearest_rank_index(count, pct)];
+}
+
+
+/**
+ * @brief Compute jitter statistics over toggle intervals.
+ *
+ * @param diffs The measured intervals in ns.
+ * @param count The number of intervals.
+ * @param expected_ns The expected interval (half period) in ns.
+ * @param tolerance_ns Intervals longer than expected_ns + tolerance_ns count as overrun.
+ * @param out The computed statistics.
+ * @return int 0 on success, or -1 on failure.
+ */
+int stats_compute(const uint64_t* diffs, size_t count, uint64_t expected_ns,
+                  uint64_t tolerance_ns, jitter_stats_t* out) {
+    if (count == 0) {
+        return -1;
+    }
+
+    int64_t* jitter = malloc(count * sizeof(int64_t));
+    if (!jitter) {
+        perror("malloc failed");
+        return -1;
+    }
+
+    double sum = 0.0;
+    out->overruns = 0;
+    for (size_t i = 0; i < count; i++) {
+        jitter[i] = (int64_t)diffs[i] - (int64_t)expected_ns;
+        sum += (double)jitter[i];
+        if (diffs[i] > expected_ns + tolerance_ns) {
+            out->overruns++;
+        }
+    }
+    out->mean = sum / (double)count;
+
+    double sq = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        double d = (double)jitter[i] - out->mean;
+        sq += d * d;
+    }
+    out->stddev = sqrt(sq / (double)count);
+
+    qsort(jitter, count, sizeof(int64_t), compare_int64);
+
+    out->count = count;
+    out->min = jitter[0];
+    out->max = jitter[count - 1];
+    out->max_abs = (-out->min > out->max) ? -out->min : out->max;
+    out->p50 = stats_percentile(jitter, count, 50.0);
+    out->p90 = stats_percentile(jitter, count, 90.0);
+    out->p99 = stats_percentile(jitter, count, 99.0);
+    out->p999 = stats_percentile(jitter, count, 99.9);
+
+    free(jitter);
+    return 0;
+}
+
+
+static int compare_uint64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+
+/**
+ * @brief Sorted copy of an array of intervals, to be freed by the caller.
+ */
+static uint64_t* sorted_copy(const uint64_t* values, size_t count) {
+    uint64_t* sorted = malloc(count * sizeof(uint64_t));
+    if (!sorted) {
+        perror("malloc failed");
+        return NULL;
+    }
+    for (size_t i = 0; i < count; i++) {
+        sorted[i] = values[i];
+    }
+    qsort(sorted, count, sizeof(uint64_t), compare_uint64);
+    return sorted;
+}
+
+
+/**
+ * @brief Two-sample Kolmogorov-Smirnov test.
+ *
+ * The p-value uses the asymptotic Kolmogorov distribution with the small sample
+ * correction from Stephens (1970), which is accurate for the sample sizes of
+ * typical runs (hundreds of samples and more).
+ *
+ * @param a The first sample.
+ * @param na The size of the first sample.
+ * @param b The second sample.
+ * @param nb The size of the second sample.
+ * @param out The test result.
+ * @return int 0 on success, or -1 on failure.
+ */
+int stats_ks_test(const uint64_t* a, size_t na, const uint64_t* b, size_t nb, ks_result_t* out) {
+    if (na == 0 || nb == 0) {
+        return -1;
+    }
+
+    uint64_t* sa = sorted_copy(a, na);
+    uint64_t* sb = sorted_copy(b, nb);
+    if (!sa || !sb) {
+        free(sa);
+        free(sb);
+        return -1;
+    }
+
+    /* Walk both sorted samples, advancing past ties in both before comparing the CDFs */
+    size_t i = 0, j = 0;
+    double d = 0.0;
+    while (i < na && j < nb) {
+        uint64_t x = (sa[i] < sb[j]) ? sa[i] : sb[j];
+        while (i < na && sa[i] == x) i++;
+        while (j < nb && sb[j] == x) j++;
+        double dist = fabs((double)i / (double)na - (double)j / (double)nb);
+        if (dist > d) {
+            d = dist;
+        }
+    }
+
+    free(sa);
+    free(sb);
+
+    double ne = (double)na * (double)nb / (double)(na + nb);
+    double sqrt_ne = sqrt(ne);
+    double lambda = (sqrt_ne + 0.12 + 0.11 / sqrt_ne) * d;
+
+    /* Q_KS(lambda) = 2 * sum_{k>=1} (-1)^(k-1) * exp(-2 k^2 lambda^2) */
+    double p = 0.0;
+    double sign = 1.0;
+    for (int k = 1; k <= 100; k++) {
+        double term = sign * 2.0 * exp(-2.0 * k * k * lambda * lambda);
+        p += term;
+        if (fabs(term) < 1e-12) {
+            break;
+        }
+        sign = -sign;
+    }
+    if (lambda < 1e-3 || p > 1.0) {
+        p = 1.0;
+    }
+    if (p < 0.0) {
+        p = 0.0;
+    }
+
+    out->d = d;
+    out->p_value = p;
+    return 0;
+}
+
+
+/**
+ * @brief xorshift64* pseudo random number generator, reproducible for a given seed.
+ */
+static inline uint64_t next_random(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+
+/**
+ * @brief k-th smallest element (0-based) of an array, reorders the array.
+ */
+static uint64_t select_kth(uint64_t* values, size_t count, size_t k) {
+    size_t lo = 0, hi = count - 1;
+    while (lo < hi) {
+        uint64_t pivot = values[lo + (hi - lo) / 2];
+        size_t i = lo, j = hi;
+        while (i <= j) {
+            while (values[i] < pivot) i++;
+            while (values[j] > pivot) j--;
+            if (i <= j) {
+                uint64_t tmp = values[i];
+                values[i] = values[j];
+                values[j] = tmp;
+                i++;
+                if (j == 0) break;
+                j--;
+            }
+        }
+        if (k <= j) {
+            hi = j;
+        } else if (k >= i) {
+            lo = i;
+        } else {
+            break;
+        }
+    }
+    return values[k];
+}
+
+
+/**
+ * @brief Nearest-rank percentile of a resample drawn with replacement.
+ */
+static uint64_t resample_percentile(const uint64_t* values, size_t count, uint64_t* scratch,
+                                    double pct, uint64_t* state) {
+    for (size_t i = 0; i < count; i++) {
+        scratch[i] = values[next_random(state) % count];
+    }
+    return select_kth(scratch, count, nearest_rank_index(count, pct));
+}
+
+
+/**
+ * @brief Bootstrap confidence interval for the difference of a percentile between two samples.
+ *
+ * Both samples are resampled with replacement <iterations> times; the interval
+ * is taken from the percentiles of the resulting differences (b - a).
+ *
+ * @param a The baseline sample.
+ * @param na The size of the baseline sample.
+ * @param b The candidate sample.
+ * @param nb The size of the candidate sample.
+ * @param pct The percentile to compare, e.g. 99.9.
+ * @param iterations The number of bootstrap resamples.
+ * @param confidence The confidence level, e.g. 0.95.
+ * @param seed Seed of the random number generator.
+ * @param out The bootstrap result.
+ * @return int 0 on success, or -1 on failure.
+ */
+int stats_bootstrap_delta(const uint64_t* a, size_t na, const uint64_t* b, size_t nb, double pct,
+                          unsigned int iterations, double confidence, uint64_t seed,
+                          bootstrap_result_t* out) {
+    if (na == 0 || nb == 0 || iterations == 0) {
+        return -1;
+    }
+
+    uint64_t* scratch = malloc(((na > nb) ? na : nb) * sizeof(uint64_t));
+    double* deltas = malloc(iterations * sizeof(double));
+    uint64_t* sa = sorted_copy(a, na);
+    uint64_t* sb = sorted_copy(b, nb);
+    if (!scratch || !deltas || !sa || !sb) {
+        perror("malloc failed");
+        free(scratch);
+        free(deltas);
+        free(sa);
+        free(sb);
+        return -1;
+    }
+
+    out->delta = (double)sb[nearest_rank_index(nb, pct)] - (double)sa[nearest_rank_index(na, pct)];
+
+    uint64_t state = (seed != 0) ? seed : 0x9E3779B97F4A7C15ULL;
+    for (unsigned int i = 0; i < iterations; i++) {
+        double ra = (double)resample_percentile(a, na, scratch, pct, &state);
+        double rb = (double)resample_percentile(b, nb, scratch, pct, &state);
+        deltas[i] = rb - ra;
+    }
+
+    qsort(deltas, iterations, sizeof(double), compare_double);
+    size_t lo = (size_t)floor((1.0 - confidence) / 2.0 * iterations);
+    size_t hi = (size_t)ceil((1.0 + confidence) / 2.0 * iterations);
+    if (hi > 0) {
+        hi--;
+    }
+    if (hi >= iterations) {
+        hi = iterations - 1;
+    }
+    out->ci_low = deltas[lo];
+    out->ci_high = deltas[hi];
+
+    free(scratch);
+    free(deltas);
+    free(sa);
+    free(sb);
+    return 0;
+}
@@ -0,0 +1,152 @@
+/**
+ * @file trace.c
+ *
+ * This file contains the ftrace integration (trace_marker and breaktrace)
+ * for the hot-path tracepoints declared in trace.h.
+ *
+ */
+
+#include "../inc/main.h"
+#include "../inc/trace.h"
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <string.h>
+
+
+#define TRACE_MARKER_MAX_LEN 128
+#define TRACEFS_FALLBACK_PATH "/sys/kernel/debug/tracing"
+
+
+int trace_marker_fd = -1;
+uint64_t trace_break_ns = 0;
+
+/* File descriptor of tracefs 'tracing_on', -1 if breaktrace is disabled */
+static int tracing_on_fd = -1;
+
+
+/**
+ * @brief Open a file in the tracefs directory for writing.
+ *
+ * @param name The file name relative to the tracefs mount point.
+ * @return int The file descriptor, or -1 on failure.
+ */
+static int open_tracefs_file(const char* name) {
+    char path[256];
+
+    snprintf(path, sizeof(path), "%s/%s", TRACEFS_PATH, name);
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        return fd;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s", TRACEFS_FALLBACK_PATH, name);
+    fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Could not open %s in tracefs. Is tracefs mounted and are you root?\n", name);
+    }
+    return fd;
+}
+
+
+/**
+ * @brief Initialize the ftrace integration.
+ *
+ * Must be called before the signal generation thread is started, so the
+ * file descriptors are already open when the hot path runs.
+ *
+ * @param use_marker Write tracepoints to the ftrace trace_marker file.
+ * @param break_ns Stop tracing if a deadline is missed by more than this, 0 to disable.
+ * @return int 0 on success, or -1 on failure.
+ */
+int trace_init(bool use_marker, uint64_t break_ns) {
+    if (use_marker) {
+        trace_marker_fd = open_tracefs_file("trace_marker");
+        if (trace_marker_fd < 0) {
+            return -1;
+        }
+    }
+
+    if (break_ns != 0) {
+        tracing_on_fd = open_tracefs_file("tracing_on");
+        if (tracing_on_fd < 0) {
+            trace_close();
+            return -1;
+        }
+        trace_break_ns = break_ns;
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Close all tracefs file descriptors.
+ */
+void trace_close(void) {
+    if (trace_marker_fd >= 0) {
+        close(trace_marker_fd);
+        trace_marker_fd = -1;
+    }
+    if (tracing_on_fd >= 0) {
+        close(tracing_on_fd);
+        tracing_on_fd = -1;
+    }
+    trace_break_ns = 0;
+}
+
+
+/**
+ * @brief Write a formatted line to the ftrace trace_marker file.
+ *
+ * Uses a single write() per line, so the marker appears as one trace event.
+ */
+void trace_marker_printf(const char* fmt, ...) {
+    char buf[TRACE_MARKER_MAX_LEN];
+    va_list ap;
+
+    va_start(ap, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+
+    if (len <= 0) {
+        return;
+    }
+    if (len >= (int)sizeof(buf)) {
+        len = sizeof(buf) - 1;
+    }
+
+    /* Nothing sensible to do on failure in the hot path */
+    if (write(trace_marker_fd, buf, len) < 0) {
+        return;
+    }
+}
+
+
+/**
+ * @brief Stop kernel tracing, similar to cyclictest's breaktrace.
+ *
+ * Only the first call has an effect; subsequent outliers are not traced anymore.
+ *
+ * @param latency_ns The latency that triggered the break.
+ */
+void trace_breaktrace(uint64_t latency_ns) {
+    if (tracing_on_fd < 0) {
+        return;
+    }
+
+    if (trace_marker_fd >= 0) {
+        trace_marker_printf("rpisignal: hit latency threshold (%" PRIu64 " > %" PRIu64 " ns)\n",
+            latency_ns, trace_break_ns);
+    }
+
+    if (write(tracing_on_fd, "0", 1) < 0) {
+        perror("Could not stop tracing");
+    }
+
+    close(tracing_on_fd);
+    tracing_on_fd = -1;
+    trace_break_ns = 0;
+
+    fprintf(stderr, "Breaktrace: latency %" PRIu64 " ns exceeded threshold, tracing stopped\n", latency_ns);
+}